@@ -0,0 +1,331 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#include "lookuptablelatencytest.h"
+#include "kimpanelagent.h"
+#include "lookuptablediff.h"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QTest>
+
+#include <algorithm>
+
+QTEST_GUILESS_MAIN(LookupTableLatencyTest)
+
+static const int s_pageSize = 10;
+static const int s_keyCount = 500;
+
+// Stands in for an IBus engine and the ibus15 panel backend: every key produces
+// a new candidate page which is sent to the panel the same way panel.cpp does.
+// The changed range comes from the backend's own lookupTableChangedRange(), but
+// the GDBus calls and their fallback in panel.cpp need ibus and are not covered
+// here, only mirrored with QtDBus.
+class MockEngine : public QObject
+{
+public:
+    explicit MockEngine(bool delta)
+        : m_connection(QDBusConnection::connectToBus(QDBusConnection::SessionBus, QStringLiteral("lookuptablemockengine")))
+        , m_delta(delta)
+    {
+    }
+
+    ~MockEngine() override
+    {
+        QDBusConnection::disconnectFromBus(m_connection.name());
+    }
+
+    bool isConnected() const
+    {
+        return m_connection.isConnected();
+    }
+
+    // Appends key to the preedit, like typing pinyin: the best matches change,
+    // the rest of the page mostly stays the same.
+    void pressKey(QChar key)
+    {
+        m_preedit.append(key);
+
+        QStringList page;
+        for (int i = 0; i < s_pageSize; i++) {
+            page << (i < 2 ? m_preedit : m_preedit.left(1)) + QString::number(i);
+        }
+
+        m_cursor = 0;
+        setPage(page);
+    }
+
+    // Moves the highlighted candidate, the page itself does not change.
+    void cursorDown()
+    {
+        m_cursor = (m_cursor + 1) % s_pageSize;
+        setPage(m_page);
+    }
+
+    QStringList page() const
+    {
+        return m_page;
+    }
+
+    int cursor() const
+    {
+        return m_cursor;
+    }
+
+    int sentEntries() const
+    {
+        return m_sentEntries;
+    }
+
+    int fullPages() const
+    {
+        return m_fullPages;
+    }
+
+private:
+    void setPage(const QStringList &page)
+    {
+        const QPair<int, int> changed = lookupTableChangedRange(m_page, page);
+
+        m_page = page;
+
+        if (m_delta && m_sent) {
+            sendDelta(changed.first, changed.second);
+        } else {
+            sendFull();
+        }
+    }
+
+    QDBusMessage createCall(const QString &method) const
+    {
+        return QDBusMessage::createMethodCall(QStringLiteral("org.kde.impanel"),
+                                              QStringLiteral("/org/kde/impanel"),
+                                              QStringLiteral("org.kde.impanel2"),
+                                              method);
+    }
+
+    void sendFull()
+    {
+        QStringList labels;
+        QStringList attrs;
+        for (int i = 0; i < m_page.size(); i++) {
+            labels << QString::number((i + 1) % 10);
+            attrs << QString();
+        }
+
+        QDBusMessage message = createCall(QStringLiteral("SetLookupTable"));
+        message << labels << m_page << attrs << true << true << m_cursor << 0;
+        m_connection.send(message);
+
+        m_sent = true;
+        m_sentEntries += m_page.size();
+        m_fullPages++;
+    }
+
+    void sendDelta(int first, int last)
+    {
+        KimpanelLookupTableEntryArgumentList entries;
+        for (int i = first; i < last; i++) {
+            entries << KimpanelLookupTableEntryArgument{QString::number((i + 1) % 10), m_page.at(i), QString()};
+        }
+
+        QDBusMessage message = createCall(QStringLiteral("SetLookupTableDelta"));
+        message << first << QVariant::fromValue(entries) << m_page.size() << true << true << m_cursor << 0;
+
+        auto *watcher = new QDBusPendingCallWatcher(m_connection.asyncCall(message), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *watcher) {
+            const QDBusPendingReply<bool> reply = *watcher;
+            if (reply.isError() || !reply.value()) {
+                sendFull();
+            }
+            watcher->deleteLater();
+        });
+
+        m_sentEntries += entries.size();
+    }
+
+    QDBusConnection m_connection;
+    bool m_delta;
+    bool m_sent = false;
+    QString m_preedit;
+    QStringList m_page;
+    int m_cursor = 0;
+    int m_sentEntries = 0;
+    int m_fullPages = 0;
+};
+
+void LookupTableLatencyTest::initTestCase()
+{
+    // Run on a bus of our own so neither a running panel nor ibus gets in the way.
+    m_busDaemon.start(QStringLiteral("dbus-daemon"), {QStringLiteral("--session"),
+                                                      QStringLiteral("--nofork"),
+                                                      QStringLiteral("--print-address")});
+    if (!m_busDaemon.waitForStarted() || !m_busDaemon.waitForReadyRead()) {
+        QSKIP("Could not start a private dbus-daemon");
+    }
+
+    const QByteArray address = m_busDaemon.readLine().trimmed();
+    QVERIFY(!address.isEmpty());
+    qputenv("DBUS_SESSION_BUS_ADDRESS", address);
+}
+
+void LookupTableLatencyTest::cleanupTestCase()
+{
+    if (m_busDaemon.state() != QProcess::NotRunning) {
+        m_busDaemon.terminate();
+        m_busDaemon.waitForFinished();
+    }
+}
+
+void LookupTableLatencyTest::init()
+{
+    m_updates = 0;
+    m_texts.clear();
+    m_cursor = -1;
+
+    m_agent.reset(new PanelAgent(nullptr));
+    connect(m_agent.data(), &PanelAgent::updateLookupTableFull, this,
+            [this](const KimpanelLookupTable &lookupTable, int cursor, int layout) {
+        Q_UNUSED(layout);
+        m_updates++;
+        m_texts.clear();
+        for (const KimpanelLookupTable::Entry &entry : lookupTable.entries) {
+            m_texts << entry.text;
+        }
+        m_cursor = cursor;
+    });
+}
+
+void LookupTableLatencyTest::cleanup()
+{
+    m_engine.reset();
+    m_agent.reset();
+}
+
+void LookupTableLatencyTest::testDeltaFallback()
+{
+    QDBusConnection other = QDBusConnection::connectToBus(QDBusConnection::SessionBus, QStringLiteral("lookuptableother"));
+    QVERIFY(other.isConnected());
+
+    // Without a previous page there is nothing to apply a delta to.
+    QDBusMessage delta = QDBusMessage::createMethodCall(QStringLiteral("org.kde.impanel"),
+                                                        QStringLiteral("/org/kde/impanel"),
+                                                        QStringLiteral("org.kde.impanel2"),
+                                                        QStringLiteral("SetLookupTableDelta"));
+    delta << 0 << QVariant::fromValue(KimpanelLookupTableEntryArgumentList()) << 1 << true << true << 0 << 0;
+
+    QDBusPendingReply<bool> reply = other.asyncCall(delta);
+    QTRY_VERIFY(reply.isFinished());
+    QVERIFY(!reply.isError());
+    QVERIFY(!reply.value());
+    QCOMPARE(m_updates, 0);
+
+    m_engine.reset(new MockEngine(true));
+    QVERIFY(m_engine->isConnected());
+
+    m_engine->pressKey(QLatin1Char('n'));
+    QTRY_COMPARE(m_updates, 1);
+    QCOMPARE(m_engine->fullPages(), 1);
+
+    // Another sender replaces the page, so the engine's next delta is refused
+    // and it has to send its page in full again.
+    QDBusMessage full = QDBusMessage::createMethodCall(QStringLiteral("org.kde.impanel"),
+                                                       QStringLiteral("/org/kde/impanel"),
+                                                       QStringLiteral("org.kde.impanel2"),
+                                                       QStringLiteral("SetLookupTable"));
+    full << QStringList{QStringLiteral("1")} << QStringList{QStringLiteral("x")} << QStringList{QString()}
+         << true << true << 0 << 0;
+    other.send(full);
+    QTRY_COMPARE(m_updates, 2);
+    QCOMPARE(m_texts, QStringList{QStringLiteral("x")});
+
+    m_engine->cursorDown();
+    QTRY_COMPARE(m_engine->fullPages(), 2);
+    QTRY_COMPARE(m_updates, 3);
+    QCOMPARE(m_texts, m_engine->page());
+    QCOMPARE(m_cursor, m_engine->cursor());
+
+    QDBusConnection::disconnectFromBus(other.name());
+}
+
+void LookupTableLatencyTest::testDeltaMatchesFull()
+{
+    m_engine.reset(new MockEngine(true));
+    QVERIFY(m_engine->isConnected());
+
+    const QString input = QStringLiteral("nihaoshijie");
+    for (const QChar key : input) {
+        m_engine->pressKey(key);
+        QTRY_COMPARE(m_texts, m_engine->page());
+
+        const int updates = m_updates;
+        m_engine->cursorDown();
+        QTRY_COMPARE(m_updates, updates + 1);
+        QCOMPARE(m_texts, m_engine->page());
+        QCOMPARE(m_cursor, m_engine->cursor());
+    }
+
+    // Only the first page went out in full, afterwards just the two changing candidates.
+    QCOMPARE(m_engine->fullPages(), 1);
+    QCOMPARE(m_engine->sentEntries(), s_pageSize + (input.size() - 1) * 2);
+}
+
+void LookupTableLatencyTest::testLatency_data()
+{
+    QTest::addColumn<bool>("delta");
+
+    QTest::newRow("full") << false;
+    QTest::newRow("delta") << true;
+}
+
+void LookupTableLatencyTest::testLatency()
+{
+    QFETCH(bool, delta);
+
+    m_engine.reset(new MockEngine(delta));
+    QVERIFY(m_engine->isConnected());
+
+    QVector<qint64> latencies;
+    latencies.reserve(s_keyCount);
+
+    QElapsedTimer timer;
+    for (int i = 0; i < s_keyCount; i++) {
+        const int updates = m_updates;
+        timer.start();
+        if (i % 2) {
+            m_engine->cursorDown();
+        } else {
+            m_engine->pressKey(QLatin1Char('a' + (i / 2) % 26));
+        }
+        // Spin the event loop ourselves, QTRY_* would add its polling interval.
+        while (m_updates == updates) {
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        }
+        latencies << timer.nsecsElapsed();
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    qInfo() << (delta ? "delta" : "full") << "key to candidate latency:"
+            << "median" << latencies.at(latencies.size() / 2) / 1000 << "us,"
+            << "p95" << latencies.at(latencies.size() * 95 / 100) / 1000 << "us,"
+            << m_engine->sentEntries() << "entries sent";
+}
@@ -0,0 +1,55 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#ifndef LOOKUPTABLELATENCYTEST_H
+#define LOOKUPTABLELATENCYTEST_H
+
+#include <QObject>
+#include <QProcess>
+#include <QScopedPointer>
+#include <QStringList>
+
+class MockEngine;
+class PanelAgent;
+
+class LookupTableLatencyTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+    void testDeltaFallback();
+    void testDeltaMatchesFull();
+    void testLatency_data();
+    void testLatency();
+
+private:
+    QProcess m_busDaemon;
+    // what the panel would show, recorded from PanelAgent::updateLookupTableFull
+    int m_updates = 0;
+    QStringList m_texts;
+    int m_cursor = -1;
+
+    QScopedPointer<PanelAgent> m_agent;
+    QScopedPointer<MockEngine> m_engine;
+};
+
+#endif // LOOKUPTABLELATENCYTEST_H
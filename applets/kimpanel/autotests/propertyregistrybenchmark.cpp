@@ -0,0 +1,198 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#include "propertyregistrybenchmark.h"
+#include "kimpanelagent.h"
+#include "kimpanelpropertymodel.h"
+
+#include <QSignalSpy>
+#include <QTest>
+
+QTEST_GUILESS_MAIN(PropertyRegistryBenchmark)
+
+// About what fcitx registers with a handful of input methods and addons enabled.
+static const int s_propertyCount = 20;
+
+static QString property(int i, const QString &icon = QStringLiteral("input-keyboard"))
+{
+    return QStringLiteral("/Fcitx/im/%1:Input Method %1:%2:Switch to input method %1:menu").arg(i).arg(icon);
+}
+
+static QStringList properties(int changed = 0)
+{
+    QStringList result;
+    for (int i = 0; i < s_propertyCount; i++) {
+        result << property(i, i < changed ? QStringLiteral("fcitx-pinyin") : QStringLiteral("input-keyboard"));
+    }
+    return result;
+}
+
+void PropertyRegistryBenchmark::initTestCase()
+{
+    // PanelAgent registers org.kde.impanel, run on a bus of our own so a
+    // running panel is neither replaced nor in the way.
+    m_busDaemon.start(QStringLiteral("dbus-daemon"), {QStringLiteral("--session"),
+                                                      QStringLiteral("--nofork"),
+                                                      QStringLiteral("--print-address")});
+    if (!m_busDaemon.waitForStarted() || !m_busDaemon.waitForReadyRead()) {
+        QSKIP("Could not start a private dbus-daemon");
+    }
+
+    const QByteArray address = m_busDaemon.readLine().trimmed();
+    QVERIFY(!address.isEmpty());
+    qputenv("DBUS_SESSION_BUS_ADDRESS", address);
+}
+
+void PropertyRegistryBenchmark::cleanupTestCase()
+{
+    if (m_busDaemon.state() != QProcess::NotRunning) {
+        m_busDaemon.terminate();
+        m_busDaemon.waitForFinished();
+    }
+}
+
+void PropertyRegistryBenchmark::testRegisterProperties()
+{
+    PanelAgent agent(nullptr);
+    KimpanelPropertyModel model;
+    connect(&agent, &PanelAgent::registerProperties, &model, &KimpanelPropertyModel::setProperties);
+
+    QSignalSpy resetSpy(&model, &QAbstractItemModel::modelReset);
+    QSignalSpy changedSpy(&model, &QAbstractItemModel::dataChanged);
+
+    agent.RegisterProperties(properties());
+    QCOMPARE(resetSpy.count(), 1);
+    QCOMPARE(model.rowCount(), s_propertyCount);
+    QCOMPARE(model.indexOf(QStringLiteral("/Fcitx/im/3")), 3);
+    QCOMPARE(model.get(3).value(QStringLiteral("label")).toString(), QStringLiteral("Input Method 3"));
+    QCOMPARE(model.get(3).value(QStringLiteral("hint")).toString(), QStringLiteral("menu"));
+
+    // Same keys, one of them with another icon: only that row changes.
+    agent.RegisterProperties(properties(1));
+    QCOMPARE(resetSpy.count(), 1);
+    QCOMPARE(changedSpy.count(), 1);
+    QCOMPARE(changedSpy.at(0).at(0).value<QModelIndex>().row(), 0);
+    QCOMPARE(model.index(0, 0).data(KimpanelPropertyModel::IconRole).toString(), QStringLiteral("fcitx-pinyin"));
+
+    // Another set of keys replaces the model.
+    agent.RegisterProperties(QStringList{property(s_propertyCount)});
+    QCOMPARE(resetSpy.count(), 2);
+    QCOMPARE(model.rowCount(), 1);
+    QCOMPARE(model.indexOf(QStringLiteral("/Fcitx/im/0")), -1);
+}
+
+void PropertyRegistryBenchmark::testUpdateProperty()
+{
+    PanelAgent agent(nullptr);
+    KimpanelPropertyModel model;
+    connect(&agent, &PanelAgent::registerProperties, &model, &KimpanelPropertyModel::setProperties);
+    connect(&agent, &PanelAgent::updateProperty, &model, &KimpanelPropertyModel::updateProperty);
+
+    agent.RegisterProperties(properties());
+
+    QSignalSpy changedSpy(&model, &QAbstractItemModel::dataChanged);
+
+    agent.UpdateProperty(property(5, QStringLiteral("fcitx-pinyin")));
+    QCOMPARE(changedSpy.count(), 1);
+    QCOMPARE(changedSpy.at(0).at(0).value<QModelIndex>().row(), 5);
+    QCOMPARE(model.index(5, 0).data(KimpanelPropertyModel::IconRole).toString(), QStringLiteral("fcitx-pinyin"));
+
+    // Nothing changed, nothing to announce.
+    agent.UpdateProperty(property(5, QStringLiteral("fcitx-pinyin")));
+    QCOMPARE(changedSpy.count(), 1);
+
+    // The update is remembered, registering the updated list again is a no-op.
+    QStringList updated = properties();
+    updated[5] = property(5, QStringLiteral("fcitx-pinyin"));
+    agent.RegisterProperties(updated);
+    QCOMPARE(changedSpy.count(), 1);
+
+    // Unknown properties are ignored.
+    agent.UpdateProperty(property(s_propertyCount));
+    QCOMPARE(changedSpy.count(), 1);
+    QCOMPARE(model.rowCount(), s_propertyCount);
+}
+
+void PropertyRegistryBenchmark::testDuplicateKeys()
+{
+    PanelAgent agent(nullptr);
+    KimpanelPropertyModel model;
+    connect(&agent, &PanelAgent::registerProperties, &model, &KimpanelPropertyModel::setProperties);
+    connect(&agent, &PanelAgent::updateProperty, &model, &KimpanelPropertyModel::updateProperty);
+
+    // The first of two rows with the same key is the one that gets updated.
+    QStringList duplicated = properties();
+    duplicated[4] = property(2);
+    agent.RegisterProperties(duplicated);
+    QCOMPARE(model.indexOf(QStringLiteral("/Fcitx/im/2")), 2);
+
+    QSignalSpy changedSpy(&model, &QAbstractItemModel::dataChanged);
+
+    agent.UpdateProperty(property(2, QStringLiteral("fcitx-pinyin")));
+    QCOMPARE(changedSpy.count(), 1);
+    QCOMPARE(changedSpy.at(0).at(0).value<QModelIndex>().row(), 2);
+    QCOMPARE(model.index(2, 0).data(KimpanelPropertyModel::IconRole).toString(), QStringLiteral("fcitx-pinyin"));
+    QCOMPARE(model.index(4, 0).data(KimpanelPropertyModel::IconRole).toString(), QStringLiteral("input-keyboard"));
+
+    // The agent remembers the update on the first row as well.
+    agent.UpdateProperty(property(2, QStringLiteral("fcitx-pinyin")));
+    QCOMPARE(changedSpy.count(), 1);
+}
+
+void PropertyRegistryBenchmark::benchmarkRegisterProperties_data()
+{
+    QTest::addColumn<int>("changed");
+
+    QTest::newRow("one changed") << 1;
+    QTest::newRow("all changed") << s_propertyCount;
+}
+
+void PropertyRegistryBenchmark::benchmarkRegisterProperties()
+{
+    QFETCH(int, changed);
+
+    PanelAgent agent(nullptr);
+    KimpanelPropertyModel model;
+    connect(&agent, &PanelAgent::registerProperties, &model, &KimpanelPropertyModel::setProperties);
+
+    // Alternate between two lists, so every call has something to parse.
+    const QStringList first = properties();
+    const QStringList second = properties(changed);
+
+    QBENCHMARK {
+        agent.RegisterProperties(first);
+        agent.RegisterProperties(second);
+    }
+}
+
+void PropertyRegistryBenchmark::benchmarkUpdateProperty()
+{
+    PanelAgent agent(nullptr);
+    KimpanelPropertyModel model;
+    connect(&agent, &PanelAgent::registerProperties, &model, &KimpanelPropertyModel::setProperties);
+    connect(&agent, &PanelAgent::updateProperty, &model, &KimpanelPropertyModel::updateProperty);
+
+    agent.RegisterProperties(properties());
+
+    const QString first = property(s_propertyCount / 2, QStringLiteral("fcitx-pinyin"));
+    const QString second = property(s_propertyCount / 2);
+
+    QBENCHMARK {
+        agent.UpdateProperty(first);
+        agent.UpdateProperty(second);
+    }
+}
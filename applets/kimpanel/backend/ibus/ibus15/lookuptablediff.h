@@ -0,0 +1,41 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of
+ *  the License or (at your option) version 3 or any later version
+ *  accepted by the membership of KDE e.V. (or its successor approved
+ *  by the membership of KDE e.V.), which shall act as a proxy
+ *  defined in Section 14 of version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LOOKUPTABLEDIFF_H
+#define LOOKUPTABLEDIFF_H
+#include <QList>
+#include <QPair>
+
+// Returns the range [first, last) of candidates in page that differs from
+// previous, i.e. what has to go into a SetLookupTableDelta call.
+template<typename T>
+QPair<int, int> lookupTableChangedRange(const QList<T> &previous, const QList<T> &page)
+{
+    int first = 0;
+    while (first < page.size() && first < previous.size()
+           && page.at(first) == previous.at(first)) {
+        first++;
+    }
+    int last = page.size();
+    while (last > first && last <= previous.size()
+           && page.at(last - 1) == previous.at(last - 1)) {
+        last--;
+    }
+    return qMakePair(first, last);
+}
+
+#endif // LOOKUPTABLEDIFF_H
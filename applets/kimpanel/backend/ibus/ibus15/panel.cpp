@@ -34,6 +34,7 @@
 #include "xkblayoutmanager.h"
 #include "app.h"
 #include "gtkaccelparse_p.h"
+#include "lookuptablediff.h"
 
 #ifndef DBUS_ERROR_FAILED
 #define DBUS_ERROR_FAILED "org.freedesktop.DBus.Error.Failed"
@@ -45,6 +46,14 @@
 
 typedef struct _IBusPanelImpanelClass IBusPanelImpanelClass;
 
+struct LookupTablePage {
+    QList<QByteArray> candidates;
+    gboolean hasPrev = TRUE;
+    gboolean hasNext = TRUE;
+    gint cursor = -1;
+    gint orientation = 0;
+};
+
 struct _IBusPanelImpanel {
     IBusPanelService    parent;
     IBusBus            *bus;
@@ -57,6 +66,13 @@ struct _IBusPanelImpanel {
     int selected;
     GSettings *settings_general;
     GSettings *settings_hotkey;
+    LookupTablePage* lookupTable;
+    // whether the panel understands SetLookupTableDelta
+    gboolean lookupTableDelta;
+    // whether the panel holds lookupTable, so the next page may be sent as delta
+    gboolean lookupTableSent;
+    // cancels pending SetLookupTableDelta calls when the panel service goes away
+    GCancellable *cancellable;
 };
 
 struct _IBusPanelImpanelClass {
@@ -668,6 +684,9 @@ impanel_panel_created_callback (GDBusConnection *connection,
     Q_UNUSED(signal_name);
     Q_UNUSED(parameters);
     IBusPanelImpanel* impanel = ((IBusPanelImpanel *)user_data);
+    // a new panel may support deltas, but does not know the current page yet
+    impanel->lookupTableDelta = TRUE;
+    impanel->lookupTableSent = FALSE;
     ibus_panel_impanel_real_register_properties(impanel);
 
 }
@@ -1026,6 +1045,10 @@ ibus_panel_impanel_init (IBusPanelImpanel *impanel)
     impanel->app = nullptr;
     impanel->useSystemKeyboardLayout = false;
     impanel->selected = -1;
+    impanel->lookupTable = new LookupTablePage;
+    impanel->lookupTableDelta = TRUE;
+    impanel->lookupTableSent = FALSE;
+    impanel->cancellable = g_cancellable_new ();
 
     introspection_data = g_dbus_node_info_new_for_xml (introspection_xml, nullptr);
     owner_id = g_bus_own_name (G_BUS_TYPE_SESSION,
@@ -1048,12 +1071,19 @@ ibus_panel_impanel_init (IBusPanelImpanel *impanel)
 static void
 ibus_panel_impanel_destroy (IBusPanelImpanel *impanel)
 {
+    if (impanel->cancellable) {
+        g_cancellable_cancel (impanel->cancellable);
+        g_clear_object (&impanel->cancellable);
+    }
+
     delete impanel->propManager;
     impanel->propManager = nullptr;
     delete impanel->engineManager;
     impanel->engineManager = nullptr;
     delete impanel->xkbLayoutManager;
     impanel->xkbLayoutManager = nullptr;
+    delete impanel->lookupTable;
+    impanel->lookupTable = nullptr;
 
     g_signal_handlers_disconnect_by_func (impanel->settings_general, (gpointer)impanel_settings_changed_callback, impanel);
     g_signal_handlers_disconnect_by_func (impanel->settings_hotkey, (gpointer)impanel_settings_changed_callback, impanel);
@@ -1201,6 +1231,113 @@ ibus_panel_impanel_update_auxiliary_text (IBusPanelService *panel,
         ibus_panel_impanel_show_auxiliary_text(panel);
 }
 
+static void
+impanel_send_lookup_table (IBusPanelImpanel *impanel)
+{
+    const LookupTablePage* page = impanel->lookupTable;
+
+    GVariantBuilder builder_labels;
+    GVariantBuilder builder_candidates;
+    GVariantBuilder builder_attrs;
+    g_variant_builder_init (&builder_labels, G_VARIANT_TYPE ("as"));
+    g_variant_builder_init (&builder_candidates, G_VARIANT_TYPE ("as"));
+    g_variant_builder_init (&builder_attrs, G_VARIANT_TYPE ("as"));
+
+    for (int i = 0; i < page->candidates.size(); i++) {
+        // NOTE ibus always return NULL for ibus_lookup_table_get_label
+        g_variant_builder_add (&builder_labels, "s", QByteArray::number((i + 1) % 10).constData());
+        g_variant_builder_add (&builder_candidates, "s", page->candidates.at(i).constData());
+        g_variant_builder_add (&builder_attrs, "s", "");
+    }
+
+    g_dbus_connection_call(impanel->conn,
+                           "org.kde.impanel",
+                           "/org/kde/impanel",
+                           "org.kde.impanel2",
+                           "SetLookupTable",
+                           (g_variant_new ("(asasasbbii)",
+                                           &builder_labels,
+                                           &builder_candidates,
+                                           &builder_attrs,
+                                           page->hasPrev, page->hasNext,
+                                           page->cursor, page->orientation)),
+                           nullptr,
+                           G_DBUS_CALL_FLAGS_NONE,
+                           -1,
+                           nullptr,
+                           nullptr,
+                           nullptr);
+    impanel->lookupTableSent = TRUE;
+}
+
+static void
+impanel_send_lookup_table_delta_callback (GObject      *source_object,
+                                          GAsyncResult *res,
+                                          gpointer      user_data)
+{
+    GError* error = nullptr;
+    GVariant* result = g_dbus_connection_call_finish (G_DBUS_CONNECTION(source_object), res, &error);
+
+    // impanel is already destroyed
+    if (!result && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_error_free (error);
+        return;
+    }
+
+    IBusPanelImpanel* impanel = ((IBusPanelImpanel *)user_data);
+    gboolean applied = FALSE;
+    if (result) {
+        g_variant_get (result, "(b)", &applied);
+        g_variant_unref (result);
+    } else {
+        // panels before SetLookupTableDelta only know SetLookupTable
+        gchar* name = g_dbus_error_get_remote_error (error);
+        if (g_strcmp0 (name, "org.freedesktop.DBus.Error.UnknownMethod") == 0) {
+            impanel->lookupTableDelta = FALSE;
+        }
+        g_free (name);
+        g_error_free (error);
+    }
+
+    // the panel had no matching page, resend the current one in full
+    if (!applied && impanel->conn && impanel->lookupTable) {
+        impanel_send_lookup_table (impanel);
+    }
+}
+
+static void
+impanel_send_lookup_table_delta (IBusPanelImpanel *impanel, int first, int last)
+{
+    const LookupTablePage* page = impanel->lookupTable;
+
+    GVariantBuilder builder_entries;
+    g_variant_builder_init (&builder_entries, G_VARIANT_TYPE ("a(sss)"));
+    for (int i = first; i < last; i++) {
+        g_variant_builder_add (&builder_entries, "(sss)",
+                               QByteArray::number((i + 1) % 10).constData(),
+                               page->candidates.at(i).constData(),
+                               "");
+    }
+
+    g_dbus_connection_call(impanel->conn,
+                           "org.kde.impanel",
+                           "/org/kde/impanel",
+                           "org.kde.impanel2",
+                           "SetLookupTableDelta",
+                           (g_variant_new ("(ia(sss)ibbii)",
+                                           first,
+                                           &builder_entries,
+                                           page->candidates.size(),
+                                           page->hasPrev, page->hasNext,
+                                           page->cursor, page->orientation)),
+                           G_VARIANT_TYPE ("(b)"),
+                           G_DBUS_CALL_FLAGS_NONE,
+                           -1,
+                           impanel->cancellable,
+                           impanel_send_lookup_table_delta_callback,
+                           impanel);
+}
+
 static void
 ibus_panel_impanel_update_lookup_table (IBusPanelService *panel,
                                         IBusLookupTable  *lookup_table,
@@ -1222,66 +1359,39 @@ ibus_panel_impanel_update_lookup_table (IBusPanelService *panel,
 
 //     fprintf(stderr, "%d ~ %d pgsize %d num %d\n", start, end, page_size, num);
 
-    guint i;
-
-    gchar label[16][4];// WARNING large enough I think --- nihui
-    const gchar *candidate;
-
-    GVariantBuilder builder_labels;
-    GVariantBuilder builder_candidates;
-    GVariantBuilder builder_attrs;
-    g_variant_builder_init (&builder_labels, G_VARIANT_TYPE ("as"));
-    g_variant_builder_init (&builder_candidates, G_VARIANT_TYPE ("as"));
-    g_variant_builder_init (&builder_attrs, G_VARIANT_TYPE ("as"));
-
-    const gchar *attr = "";
-    for (i = start; i < end; i++) {
-        g_snprintf (label[i-start], 4, "%d", (i-start+1) % 10);
-        // NOTE ibus always return NULL for ibus_lookup_table_get_label
-//         label = ibus_lookup_table_get_label(lookup_table, i)->text;
-        g_variant_builder_add (&builder_labels, "s", label[i-start]);
-
-        candidate = ibus_text_get_text (ibus_lookup_table_get_candidate (lookup_table, i));
-        g_variant_builder_add (&builder_candidates, "s", candidate);
-
-        g_variant_builder_add (&builder_attrs, "s", attr);
+    QList<QByteArray> candidates;
+    candidates.reserve(end - start);
+    for (guint i = start; i < end; i++) {
+        candidates << QByteArray(ibus_text_get_text (ibus_lookup_table_get_candidate (lookup_table, i)));
     }
 
-    gboolean has_prev = 1;
-    gboolean has_next = 1;
+    // only the range of candidates that differ from the previous page is sent to the panel
+    LookupTablePage* current = impanel->lookupTable;
+    const QPair<int, int> changed = lookupTableChangedRange(current->candidates, candidates);
+
+    current->candidates = candidates;
+    current->hasPrev = 1;
+    current->hasNext = 1;
 
-    guint cursor_pos_in_page;
     if (ibus_lookup_table_is_cursor_visible(lookup_table))
-        cursor_pos_in_page = cursor_pos % page_size;
+        current->cursor = cursor_pos % page_size;
     else
-        cursor_pos_in_page = -1;
+        current->cursor = -1;
 
     gint orientation = ibus_lookup_table_get_orientation(lookup_table);
     if (orientation == IBUS_ORIENTATION_HORIZONTAL) {
-        orientation = 2;
+        current->orientation = 2;
     } else if (orientation == IBUS_ORIENTATION_VERTICAL) {
-        orientation = 1;
+        current->orientation = 1;
     } else {
-        orientation = 0;
+        current->orientation = 0;
     }
 
-    g_dbus_connection_call(impanel->conn,
-                           "org.kde.impanel",
-                           "/org/kde/impanel",
-                           "org.kde.impanel2",
-                           "SetLookupTable",
-                           (g_variant_new ("(asasasbbii)",
-                                           &builder_labels,
-                                           &builder_candidates,
-                                           &builder_attrs,
-                                           has_prev, has_next,
-                                           cursor_pos_in_page, orientation)),
-                           nullptr,
-                           G_DBUS_CALL_FLAGS_NONE,
-                           -1,
-                           nullptr,
-                           nullptr,
-                           nullptr);
+    if (impanel->lookupTableDelta && impanel->lookupTableSent) {
+        impanel_send_lookup_table_delta(impanel, changed.first, changed.second);
+    } else {
+        impanel_send_lookup_table(impanel);
+    }
 
     if (visible == 0)
         ibus_panel_impanel_hide_lookup_table(panel);
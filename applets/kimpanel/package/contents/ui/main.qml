@@ -55,13 +55,11 @@ Item {
         property int iconSize: Math.min(units.iconSizeHints.panel, units.roundToIconSize(Math.min(width, height)))
 
         Repeater {
-            model: ListModel {
-                id: list
-                dynamicRoles: true
-            }
+            model: helper.properties
 
             delegate: Item {
                 id: iconDelegate
+                visible: plasmoid.configuration.hiddenList.indexOf(model.key) === -1
                 width: items.iconSize
                 height: items.iconSize
                 StatusIcon {
@@ -75,9 +73,6 @@ Item {
                     hint: model.hint
                     onTriggered : {
                         if (button === Qt.LeftButton) {
-                            if (model.key == 'kimpanel-placeholder') {
-                                return;
-                            }
                             helper.triggerProperty(model.key);
                             actionMenu.visualParent = statusIcon;
                         } else {
@@ -87,6 +82,28 @@ Item {
                 }
             }
         }
+
+        // Add a place holder if there is nothing.
+        Item {
+            visible: kimpanel.visibleButtons === 0 && helper.properties.count > 0
+            width: items.iconSize
+            height: items.iconSize
+            StatusIcon {
+                id: placeholderIcon
+                anchors.centerIn: parent
+                width: items.iconSize
+                height: items.iconSize
+                label: i18n("Input Method Panel")
+                tip: ""
+                icon: "draw-freehand"
+                hint: ""
+                onTriggered : {
+                    if (button !== Qt.LeftButton) {
+                        contextMenu.open(placeholderIcon, {key: 'kimpanel-placeholder', label: label});
+                    }
+                }
+            }
+        }
     }
 
     function hideAction(key) {
@@ -138,53 +155,20 @@ Item {
         id: timer
         interval: 50
         onTriggered: {
-            var data = helper.properties;
-            var nodata = data.length == 0;
-            var count = list.count;
-            var c = 0, i;
             var hiddenActions = [];
-            for (i = 0; i < data.length; i ++) {
-                if (plasmoid.configuration.hiddenList.indexOf(data[i].key) !== -1) {
-                    hiddenActions.push({'key': data[i].key,
-                                'icon': data[i].icon,
-                                'label': data[i].label});
+            var c = 0;
+            for (var i = 0; i < helper.properties.count; i ++) {
+                var property = helper.properties.get(i);
+                if (plasmoid.configuration.hiddenList.indexOf(property.key) !== -1) {
+                    hiddenActions.push({'key': property.key,
+                                'icon': property.icon,
+                                'label': property.label});
                 } else {
                     c = c + 1;
                 }
             }
-            if (c < count) {
-                list.remove(c, count - c);
-            }
             kimpanel.visibleButtons = c;
-
-            c = 0;
-            for (i = 0; i < data.length; i ++) {
-                if (plasmoid.configuration.hiddenList.indexOf(data[i].key) !== -1) {
-                    continue;
-                }
-                var itemData = {'key': data[i].key,
-                                'icon': data[i].icon,
-                                'label': data[i].label,
-                                'tip': data[i].tip,
-                                'hint': data[i].hint };
-                if (c < count) {
-                    list.set(c, itemData);
-                } else {
-                    list.append(itemData);
-                }
-                c = c + 1;
-            }
             contextMenu.actionList = hiddenActions;
-
-            // Add a place holder if there is nothing.
-            if (list.count == 0 && !nodata) {
-                var itemData = {'key': 'kimpanel-placeholder',
-                                'icon': 'draw-freehand',
-                                'label': i18n("Input Method Panel"),
-                                'tip': '',
-                                'hint': ''};
-                list.append(itemData);
-            }
         }
     }
 
@@ -193,10 +177,17 @@ Item {
     }
 
     Connections {
-        target: helper
-        function onPropertiesChanged() {
+        target: helper.properties
+        function onModelReset() {
             timer.restart();
         }
+        function onDataChanged() {
+            timer.restart();
+        }
+    }
+
+    Connections {
+        target: helper
         function onMenuTriggered(menu) {
             showMenu(actionMenu, menu);
         }
@@ -19,7 +19,7 @@
  */
 #include "kimpanel.h"
 
-Kimpanel::Kimpanel(QObject* parent) : QObject(parent), m_panelAgent(new PanelAgent(this))
+Kimpanel::Kimpanel(QObject* parent) : QObject(parent), m_panelAgent(new PanelAgent(this)), m_properties(new KimpanelPropertyModel(this))
 {
     connect(m_panelAgent, &PanelAgent::updateAux, this, &Kimpanel::updateAux);
     connect(m_panelAgent, &PanelAgent::updatePreeditText, this, &Kimpanel::updatePreeditText);
@@ -139,24 +139,19 @@ void Kimpanel::updateLookupTableFull(const KimpanelLookupTable& lookupTable, int
 
 }
 
+KimpanelPropertyModel* Kimpanel::properties() const
+{
+    return m_properties;
+}
+
 void Kimpanel::updateProperty(const KimpanelProperty& property)
 {
-    for (auto &prop : m_props) {
-        if (prop.toMap()["key"] == property.key) {
-            prop = property.toMap();
-            emit propertiesChanged();
-            break;
-        }
-    }
+    m_properties->updateProperty(property);
 }
 
 void Kimpanel::registerProperties(const QList<KimpanelProperty>& props)
 {
-    m_props.clear();
-    for (const auto &prop : props) {
-        m_props << prop.toMap();
-    }
-    emit propertiesChanged();
+    m_properties->setProperties(props);
 }
 
 void Kimpanel::execMenu(const QList<KimpanelProperty>& props)
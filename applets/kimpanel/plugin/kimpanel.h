@@ -26,6 +26,7 @@
 #include <QList>
 #include <QVariantList>
 #include "kimpanelagent.h"
+#include "kimpanelpropertymodel.h"
 
 class Kimpanel : public QObject
 {
@@ -47,7 +48,7 @@ class Kimpanel : public QObject
     Q_PROPERTY(QStringList labels MEMBER m_labels NOTIFY lookupTableChanged)
     Q_PROPERTY(QStringList texts MEMBER m_texts NOTIFY lookupTableChanged)
 
-    Q_PROPERTY(QVariantList properties MEMBER m_props NOTIFY propertiesChanged)
+    Q_PROPERTY(KimpanelPropertyModel* properties READ properties CONSTANT)
 public:
     Kimpanel(QObject* parent = nullptr);
 
@@ -60,12 +61,13 @@ public:
     Q_INVOKABLE void configure();
     Q_INVOKABLE void exit();
 
+    KimpanelPropertyModel* properties() const;
+
 signals:
     void auxTextChanged();
     void preeditTextChanged();
     void lookupTableChanged();
     void spotRectChanged();
-    void propertiesChanged();
     void menuTriggered(const QVariantList &props);
 
 private slots:
@@ -102,7 +104,7 @@ private:
     QStringList m_labels;
     QStringList m_texts;
 
-    QVariantList m_props;
+    KimpanelPropertyModel* m_properties;
 };
 
 #endif
@@ -28,10 +28,28 @@
 #include <QString>
 #include <QStringList>
 #include <QVariant>
+#include <QVector>
+#include <QDBusMetaType>
 #include <QDBusServiceWatcher>
 
 int PanelAgent::m_connectionIndex = 0;
 
+QDBusArgument &operator<<(QDBusArgument &argument, const KimpanelLookupTableEntryArgument &entry)
+{
+    argument.beginStructure();
+    argument << entry.label << entry.text << entry.attr;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, KimpanelLookupTableEntryArgument &entry)
+{
+    argument.beginStructure();
+    argument >> entry.label >> entry.text >> entry.attr;
+    argument.endStructure();
+    return argument;
+}
+
 PanelAgent::PanelAgent(QObject *parent)
     : QObject(parent)
     ,m_adaptor(new ImpanelAdaptor(this))
@@ -39,6 +57,9 @@ PanelAgent::PanelAgent(QObject *parent)
     ,m_watcher(new QDBusServiceWatcher(this))
     ,m_connection(QDBusConnection::connectToBus(QDBusConnection::SessionBus, QStringLiteral("kimpanel_bus_%0").arg(++m_connectionIndex)))
 {
+    qDBusRegisterMetaType<KimpanelLookupTableEntryArgument>();
+    qDBusRegisterMetaType<KimpanelLookupTableEntryArgumentList>();
+
     m_watcher->setConnection(QDBusConnection::sessionBus());
     m_watcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
     m_connection.registerObject(QStringLiteral("/org/kde/impanel"), this);
@@ -93,7 +114,11 @@ void PanelAgent::serviceUnregistered(const QString& service)
     if (service == m_currentService) {
         m_watcher->setWatchedServices(QStringList());
         m_cachedProps.clear();
+        m_properties.clear();
+        m_propertyRows.clear();
         m_currentService = QString();
+        m_lookupTable = KimpanelLookupTable();
+        m_lookupTableService = QString();
         emit showAux(false);
         emit showPreedit(false);
         emit showLookupTable(false);
@@ -138,9 +163,10 @@ static QList<TextAttribute> String2AttrList(const QString &str)
     if (str.isEmpty()) {
         return result;
     }
-    foreach(const QString & s, str.split(QLatin1Char(';'))) {
+    const QVector<QStringRef> attrs = str.splitRef(QLatin1Char(';'));
+    for (const QStringRef &s : attrs) {
         TextAttribute attr;
-        QStringList list = s.split(QLatin1Char(':'));
+        const QVector<QStringRef> list = s.split(QLatin1Char(':'));
         if (list.size() < 4)
             continue;
         switch (list.at(0).toInt()) {
@@ -171,16 +197,17 @@ static KimpanelProperty String2Property(const QString &str)
 {
     KimpanelProperty result;
 
-    QStringList list = str.split(QLatin1Char(':'));
+    // split into references, only the fields are copied out of str
+    const QVector<QStringRef> list = str.splitRef(QLatin1Char(':'));
 
     if (list.size() < 4)
         return result;
 
-    result.key = list.at(0);
-    result.label = list.at(1);
-    result.icon = list.at(2);
-    result.tip = list.at(3);
-    result.hint = list.size() > 4 ? list.at(4) : QString();
+    result.key = list.at(0).toString();
+    result.label = list.at(1).toString();
+    result.icon = list.at(2).toString();
+    result.tip = list.at(3).toString();
+    result.hint = list.size() > 4 ? list.at(4).toString() : QString();
 
     return result;
 }
@@ -248,25 +275,50 @@ void PanelAgent::UpdateScreen(int screen_id)
 
 void PanelAgent::UpdateProperty(const QString &prop)
 {
-    emit updateProperty(String2Property(prop));
+    const KimpanelProperty property = String2Property(prop);
+    const int row = m_propertyRows.value(property.key, -1);
+    if (row != -1) {
+        if (m_cachedProps.at(row) == prop) {
+            return;
+        }
+        m_cachedProps[row] = prop;
+        m_properties[row] = property;
+    }
+
+    emit updateProperty(property);
 }
 
 void PanelAgent::RegisterProperties(const QStringList &props)
 {
-    const QDBusMessage& msg = message();
-    if (msg.service() != m_currentService) {
+    const QString service = calledFromDBus() ? message().service() : QString();
+    if (service != m_currentService) {
         m_watcher->removeWatchedService(m_currentService);
         if (m_currentService.isEmpty()) {
             emit PanelRegistered();
         }
-        m_currentService = msg.service();
+        m_currentService = service;
         m_watcher->addWatchedService(m_currentService);
     }
     if (m_cachedProps != props) {
-        m_cachedProps = props;
         QList<KimpanelProperty> list;
-        foreach(const QString & prop, props) {
-            list << String2Property(prop);
+        list.reserve(props.size());
+        for (int i = 0; i < props.size(); i++) {
+            // usually only a few properties change between registrations
+            if (i < m_cachedProps.size() && m_cachedProps.at(i) == props.at(i)) {
+                list << m_properties.at(i);
+            } else {
+                list << String2Property(props.at(i));
+            }
+        }
+        m_cachedProps = props;
+        m_properties = list;
+
+        m_propertyRows.clear();
+        m_propertyRows.reserve(m_properties.size());
+        for (int i = 0; i < m_properties.size(); i++) {
+            if (!m_propertyRows.contains(m_properties.at(i).key)) {
+                m_propertyRows.insert(m_properties.at(i).key, i);
+            }
         }
 
         emit registerProperties(list);
@@ -295,5 +347,40 @@ void PanelAgent::SetSpotRect(int x, int y, int w, int h)
 
 void PanelAgent::SetLookupTable(const QStringList& labels, const QStringList& candis, const QStringList& attrlists, bool hasPrev, bool hasNext, int cursor, int layout)
 {
-    emit updateLookupTableFull(Args2LookupTable(labels, candis, attrlists, hasPrev, hasNext), cursor, layout);
+    m_lookupTable = Args2LookupTable(labels, candis, attrlists, hasPrev, hasNext);
+    m_lookupTableService = calledFromDBus() ? message().service() : QString();
+    emit updateLookupTableFull(m_lookupTable, cursor, layout);
+}
+
+// Entries replace the previous page starting at first, the page is then cut to count entries.
+// Returns false if there is no matching previous page, the sender has to use SetLookupTable then.
+bool PanelAgent::SetLookupTableDelta(int first, const KimpanelLookupTableEntryArgumentList &entries, int count, bool hasPrev, bool hasNext, int cursor, int layout)
+{
+    const QString service = calledFromDBus() ? message().service() : QString();
+    if (service != m_lookupTableService
+        || first < 0 || first > m_lookupTable.entries.size()
+        || count < 0 || count > qMax(m_lookupTable.entries.size(), first + entries.size())) {
+        return false;
+    }
+
+    for (int i = 0; i < entries.size(); i++) {
+        KimpanelLookupTable::Entry entry;
+        entry.label = entries.at(i).label;
+        entry.text = entries.at(i).text;
+        entry.attr = String2AttrList(entries.at(i).attr);
+
+        if (first + i < m_lookupTable.entries.size()) {
+            m_lookupTable.entries[first + i] = entry;
+        } else {
+            m_lookupTable.entries << entry;
+        }
+    }
+    while (m_lookupTable.entries.size() > count) {
+        m_lookupTable.entries.removeLast();
+    }
+
+    m_lookupTable.has_prev = hasPrev;
+    m_lookupTable.has_next = hasNext;
+    emit updateLookupTableFull(m_lookupTable, cursor, layout);
+    return true;
 }
@@ -23,11 +23,26 @@
 #include "kimpanelagenttype.h"
 
 // Qt
+#include <QHash>
 #include <QObject>
 #include <QStringList>
+#include <QDBusArgument>
 #include <QDBusContext>
 #include <QDBusConnection>
 
+// One (label, text, attr) entry of a lookup table page as sent over D-Bus
+struct KimpanelLookupTableEntryArgument {
+    QString label;
+    QString text;
+    QString attr;
+};
+typedef QList<KimpanelLookupTableEntryArgument> KimpanelLookupTableEntryArgumentList;
+
+Q_DECLARE_METATYPE(KimpanelLookupTableEntryArgument)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const KimpanelLookupTableEntryArgument &entry);
+const QDBusArgument &operator>>(const QDBusArgument &argument, KimpanelLookupTableEntryArgument &entry);
+
 class QDBusServiceWatcher;
 class Impanel2Adaptor;
 class ImpanelAdaptor;
@@ -67,6 +82,9 @@ public Q_SLOTS: // METHODS
                         const QStringList &candis,
                         const QStringList &attrlists,
                         bool hasPrev, bool hasNext, int cursor, int layout);
+    bool SetLookupTableDelta(int first,
+                             const KimpanelLookupTableEntryArgumentList &entries,
+                             int count, bool hasPrev, bool hasNext, int cursor, int layout);
     void serviceUnregistered(const QString& service);
 
 Q_SIGNALS:
@@ -108,6 +126,13 @@ Q_SIGNALS:
 private:
     QString m_currentService;
     QStringList m_cachedProps;
+    // parsed m_cachedProps, same order
+    QList<KimpanelProperty> m_properties;
+    // row of each key in m_properties, the first one for duplicate keys
+    QHash<QString, int> m_propertyRows;
+    // last page sent with SetLookupTable or SetLookupTableDelta, base for the next delta
+    KimpanelLookupTable m_lookupTable;
+    QString m_lookupTableService;
     ImpanelAdaptor* m_adaptor;
     Impanel2Adaptor* m_adaptor2;
     QDBusServiceWatcher* m_watcher;
@@ -56,6 +56,15 @@ struct KimpanelProperty {
     QString tip;
     QString hint;
 
+    bool operator==(const KimpanelProperty &other) const {
+        return key == other.key && label == other.label && icon == other.icon
+            && tip == other.tip && hint == other.hint;
+    }
+
+    bool operator!=(const KimpanelProperty &other) const {
+        return !(*this == other);
+    }
+
     QVariantMap toMap() const {
         QVariantMap map;
         map[QStringLiteral("key")] = key;
@@ -0,0 +1,125 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "kimpanelpropertymodel.h"
+
+KimpanelPropertyModel::KimpanelPropertyModel(QObject* parent) : QAbstractListModel(parent)
+{
+}
+
+QHash<int, QByteArray> KimpanelPropertyModel::roleNames() const
+{
+    return {
+        {KeyRole, QByteArrayLiteral("key")},
+        {LabelRole, QByteArrayLiteral("label")},
+        {IconRole, QByteArrayLiteral("icon")},
+        {TipRole, QByteArrayLiteral("tip")},
+        {HintRole, QByteArrayLiteral("hint")},
+    };
+}
+
+int KimpanelPropertyModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_properties.count();
+}
+
+QVariant KimpanelPropertyModel::data(const QModelIndex& index, int role) const
+{
+    if (!checkIndex(index, CheckIndexOption::IndexIsValid | CheckIndexOption::ParentIsInvalid)) {
+        return QVariant();
+    }
+
+    const KimpanelProperty &property = m_properties.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+    case LabelRole:
+        return property.label;
+    case KeyRole:
+        return property.key;
+    case IconRole:
+        return property.icon;
+    case TipRole:
+        return property.tip;
+    case HintRole:
+        return property.hint;
+    }
+
+    return QVariant();
+}
+
+QVariantMap KimpanelPropertyModel::get(int row) const
+{
+    if (row < 0 || row >= m_properties.count()) {
+        return QVariantMap();
+    }
+    return m_properties.at(row).toMap();
+}
+
+int KimpanelPropertyModel::indexOf(const QString& key) const
+{
+    return m_rows.value(key, -1);
+}
+
+void KimpanelPropertyModel::setProperties(const QList<KimpanelProperty>& properties)
+{
+    bool sameKeys = properties.count() == m_properties.count();
+    for (int i = 0; sameKeys && i < properties.count(); i++) {
+        sameKeys = properties.at(i).key == m_properties.at(i).key;
+    }
+
+    // the input method re-registered the same properties, e.g. with another icon
+    if (sameKeys) {
+        for (int i = 0; i < properties.count(); i++) {
+            if (properties.at(i) != m_properties.at(i)) {
+                m_properties[i] = properties.at(i);
+                const QModelIndex changed = index(i, 0);
+                emit dataChanged(changed, changed);
+            }
+        }
+        return;
+    }
+
+    const int oldCount = m_properties.count();
+
+    beginResetModel();
+    m_properties = properties.toVector();
+    m_rows.clear();
+    m_rows.reserve(m_properties.count());
+    for (int i = 0; i < m_properties.count(); i++) {
+        // the first of duplicate keys wins, like in updateProperty() before
+        if (!m_rows.contains(m_properties.at(i).key)) {
+            m_rows.insert(m_properties.at(i).key, i);
+        }
+    }
+    endResetModel();
+
+    if (oldCount != m_properties.count()) {
+        emit countChanged();
+    }
+}
+
+void KimpanelPropertyModel::updateProperty(const KimpanelProperty& property)
+{
+    const int row = indexOf(property.key);
+    if (row < 0 || m_properties.at(row) == property) {
+        return;
+    }
+
+    m_properties[row] = property;
+    const QModelIndex changed = index(row, 0);
+    emit dataChanged(changed, changed);
+}
@@ -0,0 +1,64 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef KIMPANELPROPERTYMODEL_H
+#define KIMPANELPROPERTYMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QVector>
+#include "kimpanelagenttype.h"
+
+// Input method properties in registration order, looked up by their key
+class KimpanelPropertyModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+public:
+    enum Roles {
+        KeyRole = Qt::UserRole + 1,
+        LabelRole,
+        IconRole,
+        TipRole,
+        HintRole
+    };
+    Q_ENUM(Roles)
+
+    explicit KimpanelPropertyModel(QObject* parent = nullptr);
+
+    QHash<int, QByteArray> roleNames() const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+
+    Q_INVOKABLE QVariantMap get(int row) const;
+    int indexOf(const QString &key) const;
+
+    // Keeps rows whose key did not move, only changed rows are announced
+    void setProperties(const QList<KimpanelProperty> &properties);
+    // Touches the row of property.key only, unknown keys are ignored
+    void updateProperty(const KimpanelProperty &property);
+
+signals:
+    void countChanged();
+
+private:
+    QVector<KimpanelProperty> m_properties;
+    QHash<QString, int> m_rows;
+};
+
+#endif
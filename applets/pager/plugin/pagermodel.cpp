@@ -20,6 +20,7 @@ Free Software Foundation, Inc.,
 *********************************************************************/
 
 #include "pagermodel.h"
+#include "windowbucketmodel.h"
 #include "windowmodel.h"
 
 #include <activityinfo.h>
@@ -59,6 +60,7 @@ public:
     QRect screenGeometry;
 
     WindowTasksModel *tasksModel = nullptr;
+    WindowBucketModel *bucketModel = nullptr;
 
     static ActivityInfo *activityInfo;
     QMetaObject::Connection activityNumberConn;
@@ -69,12 +71,25 @@ public:
     QMetaObject::Connection virtualDesktopNamesConn;
 
     QList<WindowModel *> windowModels;
+    // The pager type the current rows were created for.
+    PagerType windowModelsType = VirtualDesktops;
+
+    // Cached for WindowModel::data(Geometry), which runs for every window move.
+    QRect desktopGeometry;
+    bool mapViewport = false;
 
 #if HAVE_X11
-    QList<WId> cachedStackingOrder = KWindowSystem::stackingOrder();
+    QList<WId> cachedStackingOrder;
+    QHash<WId, int> stackingOrderIndex;
 #endif
 
     void refreshDataSource();
+    QVector<WindowBucketModel::Bucket> currentBuckets() const;
+    QVariant bucketKey(const WindowBucketModel::Bucket &bucket) const;
+    void refreshDesktopGeometry();
+#if HAVE_X11
+    void refreshStackingOrder();
+#endif
 
 private:
     PagerModel *q;
@@ -106,9 +121,7 @@ PagerModel::Private::Private(PagerModel *q)
     QObject::connect(activityInfo, &ActivityInfo::currentActivityChanged, q,
         [this]() {
             if (pagerType == VirtualDesktops && windowModels.count()) {
-                for (auto windowModel : windowModels) {
-                    windowModel->setActivity(activityInfo->currentActivity());
-                }
+                bucketModel->setBuckets(currentBuckets());
             }
         }
     );
@@ -116,8 +129,12 @@ PagerModel::Private::Private(PagerModel *q)
     QObject::connect(virtualDesktopInfo, &VirtualDesktopInfo::desktopLayoutRowsChanged,
         q, &PagerModel::layoutRowsChanged);
 
-    auto configureScreen = [q](QScreen* screen) {
+    refreshDesktopGeometry();
+
+    auto configureScreen = [this, q](QScreen* screen) {
         QObject::connect(screen, &QScreen::geometryChanged, q, &PagerModel::pagerItemSizeChanged);
+        QObject::connect(screen, &QScreen::virtualGeometryChanged, q, [this]() { refreshDesktopGeometry(); });
+        refreshDesktopGeometry();
         q->pagerItemSizeChanged();
     };
     for (QScreen* screen : qGuiApp->screens()) {
@@ -125,17 +142,16 @@ PagerModel::Private::Private(PagerModel *q)
     }
     QObject::connect(qGuiApp, &QGuiApplication::screenAdded, q, configureScreen);
     QObject::connect(qGuiApp, &QGuiApplication::screenRemoved, q, &PagerModel::pagerItemSizeChanged);
+    QObject::connect(qGuiApp, &QGuiApplication::screenRemoved, q, [this]() { refreshDesktopGeometry(); });
+    QObject::connect(qGuiApp, &QGuiApplication::primaryScreenChanged, q, [this]() { refreshDesktopGeometry(); });
+    QObject::connect(KWindowSystem::self(), &KWindowSystem::numberOfDesktopsChanged, q,
+        [this]() { refreshDesktopGeometry(); });
 
 #if HAVE_X11
-    QObject::connect(KWindowSystem::self(), &KWindowSystem::stackingOrderChanged, q,
-        [this]() {
-            cachedStackingOrder = KWindowSystem::stackingOrder();
+    refreshStackingOrder();
 
-            for (auto windowModel : windowModels) {
-                windowModel->refreshStackingOrder();
-            }
-        }
-    );
+    QObject::connect(KWindowSystem::self(), &KWindowSystem::stackingOrderChanged, q,
+        [this]() { refreshStackingOrder(); });
 #endif
 }
 
@@ -151,6 +167,89 @@ PagerModel::Private::~Private()
     }
 }
 
+QVector<WindowBucketModel::Bucket> PagerModel::Private::currentBuckets() const
+{
+    QVector<WindowBucketModel::Bucket> buckets;
+
+    if (pagerType == VirtualDesktops) {
+        const QString &activity = activityInfo->currentActivity();
+        const QVariantList &desktopIds = virtualDesktopInfo->desktopIds();
+
+        for (const QVariant &desktopId : desktopIds) {
+            buckets.append({desktopId, activity});
+        }
+    } else {
+        const QStringList &runningActivities = activityInfo->runningActivities();
+
+        for (const QString &activity : runningActivities) {
+            buckets.append({QVariant(), activity});
+        }
+    }
+
+    return buckets;
+}
+
+QVariant PagerModel::Private::bucketKey(const WindowBucketModel::Bucket &bucket) const
+{
+    // Identifies the pager item across refreshes.
+    return (pagerType == VirtualDesktops) ? bucket.virtualDesktop : QVariant(bucket.activity);
+}
+
+void PagerModel::Private::refreshDesktopGeometry()
+{
+    const QList<QScreen *> screens = QGuiApplication::screens();
+    const QRect geometry = screens.isEmpty() ? QRect() : screens.at(0)->virtualGeometry();
+    const bool viewport = KWindowSystem::mapViewport();
+
+    if (geometry == desktopGeometry && viewport == mapViewport) {
+        return;
+    }
+
+    desktopGeometry = geometry;
+    mapViewport = viewport;
+
+    for (auto windowModel : windowModels) {
+        windowModel->refreshGeometry();
+    }
+}
+
+#if HAVE_X11
+void PagerModel::Private::refreshStackingOrder()
+{
+    cachedStackingOrder = KWindowSystem::stackingOrder();
+
+    QHash<WId, int> newIndex;
+    newIndex.reserve(cachedStackingOrder.count());
+
+    for (int i = 0; i < cachedStackingOrder.count(); ++i) {
+        newIndex.insert(cachedStackingOrder.at(i), i);
+    }
+
+    // Only windows that moved within the stack, appeared or went away need updating.
+    QSet<WId> changed;
+
+    for (auto it = newIndex.constBegin(); it != newIndex.constEnd(); ++it) {
+        if (stackingOrderIndex.value(it.key(), -1) != it.value()) {
+            changed.insert(it.key());
+        }
+    }
+
+    for (auto it = stackingOrderIndex.constBegin(); it != stackingOrderIndex.constEnd(); ++it) {
+        if (!newIndex.contains(it.key())) {
+            changed.insert(it.key());
+        }
+    }
+
+    stackingOrderIndex = newIndex;
+
+    if (!changed.isEmpty()) {
+        for (auto windowModel : windowModels) {
+            windowModel->refreshStackingOrder(changed);
+        }
+    }
+}
+#endif
+
 void PagerModel::Private::refreshDataSource()
 {
     if (pagerType == VirtualDesktops) {
@@ -204,6 +303,12 @@ PagerModel::PagerModel(QObject *parent)
     , d(new Private(this))
 {
     d->tasksModel = new WindowTasksModel(this);
+
+    // A single filter pass shared by all pager items, instead of one per item.
+    d->bucketModel = new WindowBucketModel(this);
+    d->bucketModel->setFilterSkipPager(true);
+    d->bucketModel->setDemandingAttentionSkipsFilters(false);
+    d->bucketModel->setSourceModel(d->tasksModel);
 }
 
 PagerModel::~PagerModel()
@@ -240,9 +345,9 @@ QVariant PagerModel::data(const QModelIndex &index, int role) const
 
     if (role == Qt::DisplayRole) {
         if (d->pagerType == VirtualDesktops) {
-            return d->virtualDesktopInfo->desktopNames().at(index.row());
+            return d->virtualDesktopInfo->desktopNames().value(index.row());
         } else {
-            QString activityId = d->activityInfo->runningActivities().at(index.row());
+            QString activityId = d->activityInfo->runningActivities().value(index.row());
             return d->activityInfo->activityName(activityId);
         }
     } else if (role == TasksModel) {
@@ -290,6 +395,7 @@ void PagerModel::setEnabled(bool enabled)
 
         qDeleteAll(d->windowModels);
         d->windowModels.clear();
+        d->bucketModel->setBuckets({});
 
         endResetModel();
 
@@ -391,11 +497,26 @@ QSize PagerModel::pagerItemSize() const
     return totalRect.size();
 }
 
+QRect PagerModel::desktopGeometry() const
+{
+    return d->desktopGeometry;
+}
+
+bool PagerModel::mapViewport() const
+{
+    return d->mapViewport;
+}
+
 #if HAVE_X11
 QList<WId> PagerModel::stackingOrder() const
 {
     return d->cachedStackingOrder;
 }
+
+int PagerModel::stackingOrderIndex(WId window) const
+{
+    return d->stackingOrderIndex.value(window, -1);
+}
 #endif
 
 void PagerModel::refresh()
@@ -404,64 +525,95 @@ void PagerModel::refresh()
         return;
     }
 
-    beginResetModel();
+    // Only rebuild all items when switching between desktops and activities,
+    // otherwise keep the delegates of the items that are still there.
+    const bool reset = d->windowModels.isEmpty() || d->windowModelsType != d->pagerType;
 
-    d->refreshDataSource();
+    if (reset) {
+        beginResetModel();
+    }
 
-    int modelCount = d->windowModels.count();
-    const int modelsNeeded = ((d->pagerType == VirtualDesktops)
-        ? d->virtualDesktopInfo->numberOfDesktops()
-        : d->activityInfo->numberOfRunningActivities());
+    d->refreshDataSource();
 
-    if (modelCount > modelsNeeded) {
-        while (modelCount != modelsNeeded) {
-            delete d->windowModels.takeLast();
-            --modelCount;
-        }
-    } else if (modelsNeeded > modelCount) {
-        while (modelCount != modelsNeeded) {
-            WindowModel *windowModel = new WindowModel(this);
-            windowModel->setFilterSkipPager(true);
-            windowModel->setFilterByVirtualDesktop(true);
-            windowModel->setFilterByActivity(true);
-            windowModel->setDemandingAttentionSkipsFilters(false);
-            windowModel->setSourceModel(d->tasksModel);
-            d->windowModels.append(windowModel);
-            ++modelCount;
-        }
+    if (d->showOnlyCurrentScreen && d->screenGeometry.isValid()) {
+        d->bucketModel->setScreenGeometry(d->screenGeometry);
+        d->bucketModel->setFilterByScreen(true);
+    } else {
+        d->bucketModel->setFilterByScreen(false);
     }
 
-    if (d->pagerType == VirtualDesktops) {
-        int virtualDesktop = 0;
+    const QVector<WindowBucketModel::Bucket> &buckets = d->currentBuckets();
 
-        for (auto windowModel : d->windowModels) {
-            windowModel->setVirtualDesktop(d->virtualDesktopInfo->desktopIds().at(virtualDesktop));
-            ++virtualDesktop;
+    if (reset) {
+        qDeleteAll(d->windowModels);
+        d->windowModels.clear();
+
+        d->bucketModel->setBuckets(buckets);
 
-            windowModel->setActivity(d->activityInfo->currentActivity());
+        for (int i = 0; i < buckets.count(); ++i) {
+            d->windowModels.append(new WindowModel(d->bucketModel, i, this));
         }
+
+        d->windowModelsType = d->pagerType;
+
+        endResetModel();
     } else {
-        int activityIndex = 0;
-        const QStringList &runningActivities = d->activityInfo->runningActivities();
+        QVariantList keys;
+        QVariantList newKeys;
 
         for (auto windowModel : d->windowModels) {
-            windowModel->setVirtualDesktop();
+            keys.append(d->bucketKey(d->bucketModel->buckets().value(windowModel->bucket())));
+        }
 
-            windowModel->setActivity(runningActivities.at(activityIndex));
-            ++activityIndex;
+        for (const auto &bucket : buckets) {
+            newKeys.append(d->bucketKey(bucket));
         }
-    }
 
-    for (auto windowModel : d->windowModels) {
-        if (d->showOnlyCurrentScreen && d->screenGeometry.isValid()) {
-            windowModel->setScreenGeometry(d->screenGeometry);
-            windowModel->setFilterByScreen(true);
-        } else {
-            windowModel->setFilterByScreen(false);
+        for (int i = keys.count() - 1; i >= 0; --i) {
+            if (!newKeys.contains(keys.at(i))) {
+                beginRemoveRows(QModelIndex(), i, i);
+                WindowModel *windowModel = d->windowModels.takeAt(i);
+                keys.removeAt(i);
+                endRemoveRows();
+
+                // Views still hold the item until they have handled the removal.
+                windowModel->deleteLater();
+            }
         }
-    }
 
-    endResetModel();
+        // Rows before i are in their final place.
+        for (int i = 0; i < newKeys.count(); ++i) {
+            const int from = keys.indexOf(newKeys.at(i), i);
+
+            if (from == i) {
+                continue;
+            }
+
+            if (from != -1) {
+                beginMoveRows(QModelIndex(), from, from, QModelIndex(), i);
+                d->windowModels.move(from, i);
+                keys.move(from, i);
+                endMoveRows();
+            } else {
+                beginInsertRows(QModelIndex(), i, i);
+                d->windowModels.insert(i, new WindowModel(d->bucketModel, -1, this));
+                keys.insert(i, newKeys.at(i));
+                endInsertRows();
+            }
+        }
+
+        for (int i = 0; i < d->windowModels.count(); ++i) {
+            d->windowModels.at(i)->setBucket(i);
+        }
+
+        // Refilters all items against their new buckets.
+        d->bucketModel->setBuckets(buckets);
+
+        // Names may have changed along with the items.
+        if (rowCount()) {
+            emit dataChanged(index(0, 0), index(rowCount() - 1, 0), QVector<int>{Qt::DisplayRole});
+        }
+    }
 
     emit countChanged();
 }
@@ -529,8 +681,7 @@ void PagerModel::moveWindow(int window, double x, double y, const QVariant &targ
 
     if (KWindowSystem::isPlatformWayland()) {
         if (d->pagerType == VirtualDesktops) {
-            QAbstractItemModel *model = d->windowModels.at(0)->sourceModel();
-            TaskManager::WindowTasksModel *tasksModel = static_cast<TaskManager::WindowTasksModel *>(model);
+            TaskManager::WindowTasksModel *tasksModel = d->tasksModel;
 
             for (int i = 0; i < tasksModel->rowCount(); ++i) {
                 const QModelIndex &idx = tasksModel->index(i, 0);
@@ -634,8 +785,7 @@ void PagerModel::drop(QMimeData *mimeData, int modifiers, const QVariant &itemId
 
         if (d->pagerType == VirtualDesktops) {
             for (const quint32 &id : ids) {
-                QAbstractItemModel *model = d->windowModels.at(0)->sourceModel();
-                TaskManager::WindowTasksModel *tasksModel = static_cast<TaskManager::WindowTasksModel *>(model);
+                TaskManager::WindowTasksModel *tasksModel = d->tasksModel;
 
                 for (int i = 0; i < tasksModel->rowCount(); ++i) {
                     const QModelIndex &idx = tasksModel->index(i, 0);
@@ -94,8 +94,12 @@ public:
     int layoutRows() const;
     QSize pagerItemSize() const;
 
+    QRect desktopGeometry() const;
+    bool mapViewport() const;
+
 #if HAVE_X11
     QList<WId> stackingOrder() const;
+    int stackingOrderIndex(WId window) const;
 #endif
 
     Q_INVOKABLE void refresh();
@@ -0,0 +1,172 @@
+/********************************************************************
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the
+Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .
+*********************************************************************/
+
+#include "windowbucketmodel.h"
+
+#include <abstracttasksmodel.h>
+
+#include <QBitArray>
+
+using namespace TaskManager;
+
+static const QString s_nullActivity = QStringLiteral("00000000-0000-0000-0000-000000000000");
+
+class WindowBucketModel::Private
+{
+public:
+    Private(WindowBucketModel *q);
+
+    QVector<Bucket> buckets;
+    // Bucket membership of each row, indexed like the model.
+    QVector<QBitArray> rows;
+
+    QBitArray placement(int row) const;
+    void updateRows(int first, int last);
+    void rebuild();
+
+private:
+    WindowBucketModel *q;
+};
+
+WindowBucketModel::Private::Private(WindowBucketModel *q)
+    : q(q)
+{
+}
+
+QBitArray WindowBucketModel::Private::placement(int row) const
+{
+    QBitArray bits(buckets.count());
+
+    const QModelIndex &idx = q->index(row, 0);
+
+    // Same rules as TaskFilterProxyModel's virtual desktop and activity filters.
+    const bool onAllDesktops = idx.data(AbstractTasksModel::IsOnAllVirtualDesktops).toBool();
+    const QVariantList &desktops = idx.data(AbstractTasksModel::VirtualDesktops).toList();
+    const QStringList &activities = idx.data(AbstractTasksModel::Activities).toStringList();
+    const bool onAllActivities = activities.isEmpty() || activities.contains(s_nullActivity);
+
+    for (int i = 0; i < buckets.count(); ++i) {
+        const Bucket &bucket = buckets.at(i);
+
+        const bool onDesktop = bucket.virtualDesktop.isNull() || onAllDesktops
+            || desktops.isEmpty() || desktops.contains(bucket.virtualDesktop);
+        const bool onActivity = bucket.activity.isEmpty() || onAllActivities
+            || activities.contains(bucket.activity);
+
+        bits.setBit(i, onDesktop && onActivity);
+    }
+
+    return bits;
+}
+
+void WindowBucketModel::Private::updateRows(int first, int last)
+{
+    for (int i = first; i <= last; ++i) {
+        rows[i] = placement(i);
+    }
+}
+
+void WindowBucketModel::Private::rebuild()
+{
+    rows.fill(QBitArray(), q->rowCount());
+
+    if (!rows.isEmpty()) {
+        updateRows(0, rows.count() - 1);
+    }
+}
+
+bool WindowBucketModel::Bucket::operator==(const Bucket &other) const
+{
+    return virtualDesktop == other.virtualDesktop && activity == other.activity;
+}
+
+bool WindowBucketModel::Bucket::operator!=(const Bucket &other) const
+{
+    return !(*this == other);
+}
+
+WindowBucketModel::WindowBucketModel(QObject *parent)
+    : TaskFilterProxyModel(parent)
+    , d(new Private(this))
+{
+    // These connections are made before any WindowModel connects to us, so
+    // the buckets are up to date by the time the views filter a row.
+    connect(this, &QAbstractItemModel::rowsInserted, this,
+        [this](const QModelIndex &parent, int first, int last) {
+            if (!parent.isValid()) {
+                d->rows.insert(first, last - first + 1, QBitArray());
+                d->updateRows(first, last);
+            }
+        }
+    );
+
+    connect(this, &QAbstractItemModel::rowsRemoved, this,
+        [this](const QModelIndex &parent, int first, int last) {
+            if (!parent.isValid()) {
+                d->rows.remove(first, last - first + 1);
+            }
+        }
+    );
+
+    connect(this, &QAbstractItemModel::dataChanged, this,
+        [this](const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles) {
+            if (topLeft.parent().isValid()) {
+                return;
+            }
+
+            if (roles.isEmpty() || roles.contains(AbstractTasksModel::IsOnAllVirtualDesktops)
+                || roles.contains(AbstractTasksModel::VirtualDesktops)
+                || roles.contains(AbstractTasksModel::Activities)) {
+                d->updateRows(topLeft.row(), bottomRight.row());
+            }
+        }
+    );
+
+    connect(this, &QAbstractItemModel::rowsMoved, this, [this]() { d->rebuild(); });
+    connect(this, &QAbstractItemModel::layoutChanged, this, [this]() { d->rebuild(); });
+    connect(this, &QAbstractItemModel::modelReset, this, [this]() { d->rebuild(); });
+}
+
+WindowBucketModel::~WindowBucketModel()
+{
+}
+
+QVector<WindowBucketModel::Bucket> WindowBucketModel::buckets() const
+{
+    return d->buckets;
+}
+
+void WindowBucketModel::setBuckets(const QVector<Bucket> &buckets)
+{
+    if (d->buckets != buckets) {
+        d->buckets = buckets;
+        d->rebuild();
+
+        emit bucketsChanged();
+    }
+}
+
+bool WindowBucketModel::isInBucket(int row, int bucket) const
+{
+    if (row < 0 || row >= d->rows.count()) {
+        return false;
+    }
+
+    const QBitArray &bits = d->rows.at(row);
+
+    return bucket >= 0 && bucket < bits.size() && bits.testBit(bucket);
+}
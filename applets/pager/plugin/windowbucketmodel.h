@@ -0,0 +1,64 @@
+/********************************************************************
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the
+Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .
+*********************************************************************/
+
+#ifndef WINDOWBUCKETMODEL_H
+#define WINDOWBUCKETMODEL_H
+
+#include "taskfilterproxymodel.h"
+
+#include <QVector>
+
+/**
+ * Filters the windows shown by the pager and sorts them into buckets, one
+ * per pager item, in a single pass.
+ *
+ * Each bucket collects the windows on a virtual desktop and activity. The
+ * bucket membership of a row is computed once whenever the row is added or
+ * its placement changes, so the per-item WindowModel views only need to
+ * look it up.
+ */
+class WindowBucketModel : public TaskManager::TaskFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    struct Bucket {
+        // A null virtual desktop or empty activity matches any.
+        QVariant virtualDesktop;
+        QString activity;
+
+        bool operator==(const Bucket &other) const;
+        bool operator!=(const Bucket &other) const;
+    };
+
+    explicit WindowBucketModel(QObject *parent = nullptr);
+    ~WindowBucketModel() override;
+
+    QVector<Bucket> buckets() const;
+    void setBuckets(const QVector<Bucket> &buckets);
+
+    bool isInBucket(int row, int bucket) const;
+
+Q_SIGNALS:
+    void bucketsChanged() const;
+
+private:
+    class Private;
+    QScopedPointer<Private> d;
+};
+
+#endif
@@ -19,14 +19,11 @@ Free Software Foundation, Inc.,
 
 #include "windowmodel.h"
 #include "pagermodel.h"
+#include "windowbucketmodel.h"
 
 #include <abstracttasksmodel.h>
 
-#include <QGuiApplication>
 #include <QMetaEnum>
-#include <QScreen>
-
-#include <KWindowSystem>
 
 #include <algorithm>
 
@@ -38,6 +35,14 @@ public:
     Private(WindowModel *q);
 
     PagerModel *pagerModel = nullptr;
+    WindowBucketModel *bucketModel = nullptr;
+    int bucket = -1;
+
+    // Translation applied to window geometry when filtering by screen.
+    bool translateToScreen = false;
+    QPoint screenOffset;
+
+    void updateScreenOffset();
 
 private:
     WindowModel *q;
@@ -49,11 +54,33 @@ WindowModel::Private::Private(WindowModel *q)
     Q_UNUSED(this->q);
 }
 
-WindowModel::WindowModel(PagerModel *parent)
-    : TaskFilterProxyModel(parent)
+void WindowModel::Private::updateScreenOffset()
+{
+    translateToScreen = bucketModel->filterByScreen() && bucketModel->screenGeometry().isValid();
+    screenOffset = translateToScreen ? bucketModel->screenGeometry().topLeft() : QPoint();
+}
+
+WindowModel::WindowModel(WindowBucketModel *bucketModel, int bucket, PagerModel *parent)
+    : QSortFilterProxyModel(parent)
     , d(new Private(this))
 {
     d->pagerModel = parent;
+    d->bucketModel = bucketModel;
+    d->bucket = bucket;
+
+    d->updateScreenOffset();
+
+    connect(bucketModel, &TaskFilterProxyModel::filterByScreenChanged, this, [this]() { d->updateScreenOffset(); });
+    connect(bucketModel, &TaskFilterProxyModel::screenGeometryChanged, this, [this]() { d->updateScreenOffset(); });
+
+    connect(bucketModel, &WindowBucketModel::bucketsChanged, this,
+        [this]() {
+            invalidateFilter();
+            emit bucketChanged();
+        }
+    );
+
+    setSourceModel(bucketModel);
 }
 
 WindowModel::~WindowModel()
@@ -62,7 +89,7 @@ WindowModel::~WindowModel()
 
 QHash<int, QByteArray> WindowModel::roleNames() const
 {
-    QHash<int, QByteArray> roles = TaskFilterProxyModel::roleNames();
+    QHash<int, QByteArray> roles = QSortFilterProxyModel::roleNames();
 
     QMetaEnum e = metaObject()->enumerator(metaObject()->indexOfEnumerator("WindowModelRoles"));
 
@@ -76,11 +103,15 @@ QHash<int, QByteArray> WindowModel::roleNames() const
 QVariant WindowModel::data(const QModelIndex &index, int role) const
 {
     if (role == AbstractTasksModel::Geometry) {
-        QRect windowGeo = TaskFilterProxyModel::data(index, role).toRect();
-        QList<QScreen *> screens = QGuiApplication::screens();
-        const QRect desktopGeo = screens.at(0)->virtualGeometry();
+        QRect windowGeo = QSortFilterProxyModel::data(index, role).toRect();
+        const QRect &desktopGeo = d->pagerModel->desktopGeometry();
+
+        // Without screens there is nothing to map to or clamp against.
+        if (desktopGeo.isEmpty()) {
+            return windowGeo;
+        }
 
-        if (KWindowSystem::mapViewport()) {
+        if (d->pagerModel->mapViewport()) {
             int x = windowGeo.center().x() % desktopGeo.width();
             int y = windowGeo.center().y() % desktopGeo.height();
 
@@ -95,15 +126,11 @@ QVariant WindowModel::data(const QModelIndex &index, int role) const
             const QRect mappedGeo(x - windowGeo.width() / 2, y - windowGeo.height() / 2,
                 windowGeo.width(), windowGeo.height());
 
-            if (filterByScreen() && screenGeometry().isValid()) {
-                const QPoint &screenOffset = screenGeometry().topLeft();
-
-                windowGeo = mappedGeo.translated(0 - screenOffset.x(), 0 - screenOffset.y());
+            if (d->translateToScreen) {
+                windowGeo = mappedGeo.translated(-d->screenOffset);
             }
-        } else if (filterByScreen() && screenGeometry().isValid()) {
-            const QPoint &screenOffset = screenGeometry().topLeft();
-
-            windowGeo.translate(0 - screenOffset.x(), 0 - screenOffset.y());
+        } else if (d->translateToScreen) {
+            windowGeo.translate(-d->screenOffset);
         }
 
         // Clamp to desktop rect.
@@ -122,11 +149,11 @@ QVariant WindowModel::data(const QModelIndex &index, int role) const
         return windowGeo;
     } else if (role == StackingOrder) {
 #if HAVE_X11
-        const QVariantList &winIds = TaskFilterProxyModel::data(index, AbstractTasksModel::WinIdList).toList();
+        const QVariantList &winIds = QSortFilterProxyModel::data(index, AbstractTasksModel::WinIdList).toList();
 
         if (winIds.count()) {
             const WId winId = winIds.at(0).toLongLong();
-            const int z = d->pagerModel->stackingOrder().indexOf(winId);
+            const int z = d->pagerModel->stackingOrderIndex(winId);
 
             if (z != -1) {
                 return z;
@@ -137,12 +164,62 @@ QVariant WindowModel::data(const QModelIndex &index, int role) const
         return 0;
     }
 
-    return TaskFilterProxyModel::data(index, role);
+    return QSortFilterProxyModel::data(index, role);
+}
+
+int WindowModel::bucket() const
+{
+    return d->bucket;
+}
+
+void WindowModel::setBucket(int bucket)
+{
+    d->bucket = bucket;
+}
+
+QVariant WindowModel::virtualDesktop() const
+{
+    return d->bucketModel->buckets().value(d->bucket).virtualDesktop;
+}
+
+QString WindowModel::activity() const
+{
+    return d->bucketModel->buckets().value(d->bucket).activity;
+}
+
+bool WindowModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    Q_UNUSED(sourceParent)
+
+    return d->bucketModel->isInBucket(sourceRow, d->bucket);
 }
 
-void WindowModel::refreshStackingOrder()
+void WindowModel::refreshGeometry()
 {
     if (rowCount()) {
-        emit dataChanged(index(0, 0), index(rowCount() - 1, 0), QVector<int>{StackingOrder});
+        emit dataChanged(index(0, 0), index(rowCount() - 1, 0), QVector<int>{AbstractTasksModel::Geometry});
+    }
+}
+
+void WindowModel::refreshStackingOrder(const QSet<WId> &windows)
+{
+    const int count = rowCount();
+    int first = -1;
+
+    // Emit one dataChanged() per run of consecutive affected rows.
+    for (int i = 0; i <= count; ++i) {
+        bool affected = false;
+
+        if (i < count) {
+            const QVariantList &winIds = QSortFilterProxyModel::data(index(i, 0), AbstractTasksModel::WinIdList).toList();
+            affected = !winIds.isEmpty() && windows.contains(winIds.at(0).toLongLong());
+        }
+
+        if (affected && first == -1) {
+            first = i;
+        } else if (!affected && first != -1) {
+            emit dataChanged(index(first, 0), index(i - 1, 0), QVector<int>{StackingOrder});
+            first = -1;
+        }
     }
 }
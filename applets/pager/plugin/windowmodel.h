@@ -20,29 +20,53 @@ Free Software Foundation, Inc.,
 #ifndef WINDOWMODEL_H
 #define WINDOWMODEL_H
 
-#include "taskfilterproxymodel.h"
+#include <QSet>
+#include <QSortFilterProxyModel>
+#include <qwindowdefs.h>
 
 class PagerModel;
+class WindowBucketModel;
 
-class WindowModel : public TaskManager::TaskFilterProxyModel
+// The windows of a single pager item, i.e. one bucket of the WindowBucketModel.
+class WindowModel : public QSortFilterProxyModel
 {
     Q_OBJECT
 
     Q_ENUMS(WindowModelRoles)
 
+    Q_PROPERTY(QVariant virtualDesktop READ virtualDesktop NOTIFY bucketChanged)
+    Q_PROPERTY(QString activity READ activity NOTIFY bucketChanged)
+
 public:
     enum WindowModelRoles {
         StackingOrder = Qt::UserRole + 1
     };
 
-    explicit WindowModel(PagerModel *parent);
+    WindowModel(WindowBucketModel *bucketModel, int bucket, PagerModel *parent);
     ~WindowModel() override;
 
     QHash<int, QByteArray> roleNames() const override;
 
     QVariant data(const QModelIndex &index, int role) const override;
 
-    void refreshStackingOrder();
+    int bucket() const;
+    // Takes effect once the bucket model's buckets are updated.
+    void setBucket(int bucket);
+
+    QVariant virtualDesktop() const;
+    QString activity() const;
+
+    // Notifies about the geometry of all rows, e.g. after the desktop was resized.
+    void refreshGeometry();
+
+    // Notifies about the stacking order of the rows showing the given windows.
+    void refreshStackingOrder(const QSet<WId> &windows);
+
+Q_SIGNALS:
+    void bucketChanged() const;
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
 
 private:
     class Private;
@@ -0,0 +1,106 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#include "badgevisibilitytest.h"
+#include "smartlaunchers/badgevisibility.h"
+
+#include <QSignalSpy>
+#include <QTest>
+
+using namespace SmartLauncher;
+
+QTEST_GUILESS_MAIN(BadgeVisibilityTest)
+
+void BadgeVisibilityTest::init()
+{
+    m_now = QDateTime(QDate(2020, 1, 1), QTime(12, 0), Qt::UTC);
+}
+
+void BadgeVisibilityTest::testDefaults()
+{
+    BadgeVisibility visibility;
+    QVERIFY(visibility.visible());
+}
+
+void BadgeVisibilityTest::testInputs()
+{
+    BadgeVisibility visibility;
+    visibility.setClock([this] { return m_now; });
+
+    QSignalSpy spy(&visibility, &BadgeVisibility::visibleChanged);
+
+    visibility.setBadgesEnabled(false);
+    QVERIFY(!visibility.visible());
+    visibility.setBadgesEnabled(true);
+    QVERIFY(visibility.visible());
+
+    visibility.setInhibitedByApplication(true);
+    QVERIFY(!visibility.visible());
+    visibility.setInhibitedByApplication(false);
+    QVERIFY(visibility.visible());
+
+    // an inhibition that already ended doesn't hide anything
+    visibility.setInhibitedUntil(m_now.addSecs(-60));
+    QVERIFY(visibility.visible());
+
+    QCOMPARE(spy.count(), 4);
+
+    // setting the same value again doesn't re-evaluate
+    visibility.setBadgesEnabled(true);
+    QCOMPARE(spy.count(), 4);
+}
+
+void BadgeVisibilityTest::testInhibitionExpiry()
+{
+    BadgeVisibility visibility;
+    visibility.setClock([this] { return m_now; });
+
+    QSignalSpy spy(&visibility, &BadgeVisibility::visibleChanged);
+
+    visibility.setInhibitedUntil(m_now.addMSecs(50));
+    QVERIFY(!visibility.visible());
+    QCOMPARE(spy.count(), 1);
+
+    // pretend the period is over by the time the timer fires
+    m_now = m_now.addSecs(60);
+
+    QVERIFY(spy.wait());
+    QVERIFY(visibility.visible());
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(spy.last().at(0).toBool(), true);
+}
+
+void BadgeVisibilityTest::testEarlyWakeUp()
+{
+    BadgeVisibility visibility;
+    visibility.setClock([this] { return m_now; });
+
+    QSignalSpy spy(&visibility, &BadgeVisibility::visibleChanged);
+
+    visibility.setInhibitedUntil(m_now.addMSecs(50));
+    QVERIFY(!visibility.visible());
+
+    // the clock didn't advance as far as the timer, e.g. it was adjusted
+    // meanwhile, so badges stay hidden and the timer is armed again
+    QVERIFY(!spy.wait(200));
+    QVERIFY(!visibility.visible());
+
+    m_now = m_now.addSecs(60);
+
+    QVERIFY(spy.wait());
+    QVERIFY(visibility.visible());
+}
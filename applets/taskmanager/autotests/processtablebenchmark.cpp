@@ -0,0 +1,150 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#include "processtablebenchmark.h"
+#include "processtable.h"
+
+#include <QCoreApplication>
+#include <QTest>
+
+#include <processcore/process.h>
+#include <processcore/processes.h>
+
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+
+QTEST_GUILESS_MAIN(ProcessTableBenchmark)
+
+// Roughly the number of processes a busy session has.
+static const int s_childCount = 500;
+
+void ProcessTableBenchmark::initTestCase()
+{
+    for (int i = 0; i < s_childCount; ++i) {
+        const pid_t pid = fork();
+
+        if (pid == 0) {
+            // Just sit there until killed in cleanupTestCase().
+            for (;;) {
+                pause();
+            }
+        }
+
+        QVERIFY2(pid > 0, "fork() failed");
+
+        m_children.append(pid);
+    }
+}
+
+void ProcessTableBenchmark::cleanupTestCase()
+{
+    for (qint64 pid : qAsConst(m_children)) {
+        kill(pid, SIGKILL);
+    }
+
+    for (qint64 pid : qAsConst(m_children)) {
+        waitpid(pid, nullptr, 0);
+    }
+
+    m_children.clear();
+}
+
+void ProcessTableBenchmark::testParentPid()
+{
+    ProcessTable table;
+
+    const qint64 self = QCoreApplication::applicationPid();
+
+    for (qint64 pid : qAsConst(m_children)) {
+        QCOMPARE(table.parentPid(pid), self);
+    }
+}
+
+void ProcessTableBenchmark::testUnknownPid()
+{
+    ProcessTable table;
+
+    QCOMPARE(table.parentPid(-1), qint64(-1));
+}
+
+void ProcessTableBenchmark::testExitedPid()
+{
+    const int maxAge = 100;
+    ProcessTable table(maxAge);
+
+    const pid_t pid = fork();
+
+    if (pid == 0) {
+        for (;;) {
+            pause();
+        }
+    }
+
+    QVERIFY2(pid > 0, "fork() failed");
+
+    QCOMPARE(table.parentPid(pid), QCoreApplication::applicationPid());
+
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+
+    // The parent is cached until the entry expires, wait for that.
+    QTest::qWait(maxAge * 2);
+
+    QCOMPARE(table.parentPid(pid), qint64(-1));
+}
+
+void ProcessTableBenchmark::benchmarkRescan()
+{
+    // What Backend::parentPid() used to do for every lookup.
+    QBENCHMARK {
+        for (qint64 pid : qAsConst(m_children)) {
+            KSysGuard::Processes procs;
+            procs.updateOrAddProcess(pid);
+
+            KSysGuard::Process *proc = procs.getProcess(pid);
+            QVERIFY(proc);
+        }
+    }
+}
+
+void ProcessTableBenchmark::benchmarkColdLookup()
+{
+    QBENCHMARK {
+        ProcessTable table;
+
+        for (qint64 pid : qAsConst(m_children)) {
+            table.parentPid(pid);
+        }
+    }
+}
+
+void ProcessTableBenchmark::benchmarkCachedLookup()
+{
+    // Long enough for the entries not to expire while benchmarking.
+    ProcessTable table(3600000);
+
+    for (qint64 pid : qAsConst(m_children)) {
+        table.parentPid(pid);
+    }
+
+    QBENCHMARK {
+        for (qint64 pid : qAsConst(m_children)) {
+            table.parentPid(pid);
+        }
+    }
+}
@@ -0,0 +1,176 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#include "smartlauncherbackendtest.h"
+#include "smartlaunchers/smartlauncherbackend.h"
+
+#include <QDBusMessage>
+#include <QDir>
+#include <QFile>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTest>
+
+#include <KSycoca>
+
+QTEST_GUILESS_MAIN(SmartLauncherBackendTest)
+
+static const QString s_storageId = QStringLiteral("org.kde.smartlaunchertest.desktop");
+static const QString s_launcherUri = QStringLiteral("application://org.kde.smartlaunchertest.desktop");
+
+// Number of updates sent in one go, more than a chat client would send in a burst.
+static const int s_updateCount = 5000;
+
+// The backend warns every time it fails to look up the service of a launcher.
+static int s_failedLookups = 0;
+static QtMessageHandler s_previousMessageHandler = nullptr;
+
+static void countFailedLookups(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    if (type == QtWarningMsg && message.startsWith(QLatin1String("Failed to find service for Unity Launcher"))) {
+        s_failedLookups++;
+        return;
+    }
+
+    s_previousMessageHandler(type, context, message);
+}
+
+void SmartLauncherBackendTest::initTestCase()
+{
+    // Run on a bus of our own, so running applications can't send updates of
+    // their own and the test can't disturb the task manager of the session.
+    m_busDaemon.start(QStringLiteral("dbus-daemon"), {QStringLiteral("--session"),
+                                                      QStringLiteral("--nofork"),
+                                                      QStringLiteral("--print-address")});
+    if (!m_busDaemon.waitForStarted() || !m_busDaemon.waitForReadyRead()) {
+        QSKIP("Could not start a private dbus-daemon");
+    }
+
+    const QByteArray address = m_busDaemon.readLine().trimmed();
+    QVERIFY(!address.isEmpty());
+    qputenv("DBUS_SESSION_BUS_ADDRESS", address);
+
+    QVERIFY(QDBusConnection::sessionBus().isConnected());
+
+    QStandardPaths::setTestModeEnabled(true);
+
+    const QString applicationsPath = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)
+        + QStringLiteral("/applications");
+    QVERIFY(QDir().mkpath(applicationsPath));
+
+    QFile desktopFile(applicationsPath + QLatin1Char('/') + s_storageId);
+    QVERIFY(desktopFile.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    desktopFile.write("[Desktop Entry]\n"
+                      "Type=Application\n"
+                      "Name=Smart Launcher Test\n"
+                      "Exec=true\n");
+    desktopFile.close();
+
+    KSycoca::self()->ensureCacheValid();
+
+    m_backend.reset(new SmartLauncher::Backend);
+
+    // Updates have to come from another connection, just like from an application.
+    m_sender.reset(new QDBusConnection(QDBusConnection::connectToBus(QDBusConnection::SessionBus,
+                                                                     QStringLiteral("smartlaunchertest"))));
+    QVERIFY(m_sender->isConnected());
+}
+
+void SmartLauncherBackendTest::cleanupTestCase()
+{
+    m_backend.reset();
+
+    if (m_sender) {
+        m_sender.reset();
+        QDBusConnection::disconnectFromBus(QStringLiteral("smartlaunchertest"));
+    }
+
+    if (m_busDaemon.state() != QProcess::NotRunning) {
+        m_busDaemon.terminate();
+        m_busDaemon.waitForFinished();
+    }
+}
+
+void SmartLauncherBackendTest::sendUpdate(const QString &uri, const QVariantMap &properties)
+{
+    QDBusMessage message = QDBusMessage::createSignal(QStringLiteral("/org/kde/smartlaunchertest"),
+                                                      QStringLiteral("com.canonical.Unity.LauncherEntry"),
+                                                      QStringLiteral("Update"));
+    message << uri << properties;
+
+    QVERIFY(m_sender->send(message));
+}
+
+void SmartLauncherBackendTest::testUpdateStorm()
+{
+    QSignalSpy countSpy(m_backend.data(), &SmartLauncher::Backend::countChanged);
+    QSignalSpy progressSpy(m_backend.data(), &SmartLauncher::Backend::progressChanged);
+
+    for (int i = 1; i <= s_updateCount; ++i) {
+        sendUpdate(s_launcherUri, {
+            {QStringLiteral("count"), i},
+            {QStringLiteral("count-visible"), true},
+            {QStringLiteral("progress"), double(i) / s_updateCount},
+            {QStringLiteral("progress-visible"), true}
+        });
+    }
+
+    // Messages from one connection arrive in order, so once the backend's connection
+    // answered a ping sent after the burst, all updates are queued for this thread.
+    // The blocking call doesn't spin the event loop, the backend sees them all at once.
+    const QDBusMessage ping = QDBusMessage::createMethodCall(QDBusConnection::sessionBus().baseService(),
+                                                             QStringLiteral("/"),
+                                                             QStringLiteral("org.freedesktop.DBus.Peer"),
+                                                             QStringLiteral("Ping"));
+    QCOMPARE(m_sender->call(ping).type(), QDBusMessage::ReplyMessage);
+    QCOMPARE(countSpy.count(), 0);
+
+    QTRY_COMPARE(m_backend->count(s_storageId), s_updateCount);
+    QCOMPARE(m_backend->progress(s_storageId), 100);
+
+    QVERIFY(m_backend->hasLauncher(s_storageId));
+    QVERIFY(m_backend->countVisible(s_storageId));
+
+    // The whole burst is merged into a single update.
+    QCOMPARE(countSpy.count(), 1);
+    QCOMPARE(countSpy.first().at(1).toInt(), s_updateCount);
+    QCOMPARE(progressSpy.count(), 1);
+    QCOMPARE(progressSpy.first().at(1).toInt(), 100);
+}
+
+void SmartLauncherBackendTest::testUnknownLauncher()
+{
+    const QString unknownUri = QStringLiteral("application://org.kde.doesnotexist.desktop");
+
+    s_failedLookups = 0;
+    s_previousMessageHandler = qInstallMessageHandler(countFailedLookups);
+
+    for (int i = 0; i < s_updateCount; ++i) {
+        sendUpdate(unknownUri, {{QStringLiteral("count"), i}});
+    }
+
+    // Flush by sending an update for a known launcher and waiting for it.
+    sendUpdate(s_launcherUri, {{QStringLiteral("count"), 1}});
+    QTRY_COMPARE(m_backend->count(s_storageId), 1);
+
+    qInstallMessageHandler(s_previousMessageHandler);
+
+    QVERIFY(!m_backend->hasLauncher(QStringLiteral("org.kde.doesnotexist.desktop")));
+
+    // Only the first update looked for a service, the others hit the negative cache.
+    QCOMPARE(s_failedLookups, 1);
+}
@@ -0,0 +1,49 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#ifndef SMARTLAUNCHERBACKENDTEST_H
+#define SMARTLAUNCHERBACKENDTEST_H
+
+#include <QDBusConnection>
+#include <QObject>
+#include <QProcess>
+#include <QScopedPointer>
+
+namespace SmartLauncher {
+class Backend;
+}
+
+class SmartLauncherBackendTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testUpdateStorm();
+    void testUnknownLauncher();
+
+private:
+    void sendUpdate(const QString &uri, const QVariantMap &properties);
+
+    QProcess m_busDaemon;
+    QScopedPointer<SmartLauncher::Backend> m_backend;
+    QScopedPointer<QDBusConnection> m_sender;
+};
+
+#endif // SMARTLAUNCHERBACKENDTEST_H
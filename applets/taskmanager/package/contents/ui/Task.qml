@@ -125,6 +125,9 @@ MouseArea {
             if (inPopup) {
                 forceActiveFocus();
             }
+
+            // Have the recent files ready by the time the context menu opens.
+            backend.prefetchRecentDocuments(model.LauncherUrlWithoutIcon);
         } else {
             pressed = false;
         }
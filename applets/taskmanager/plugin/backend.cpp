@@ -18,6 +18,7 @@
  ***************************************************************************/
 
 #include "backend.h"
+#include "processtable.h"
 
 #include <KConfigGroup>
 #include <KDesktopFile>
@@ -27,6 +28,7 @@
 #include <KNotificationJobUiDelegate>
 #include <KService>
 #include <KServiceAction>
+#include <KSycoca>
 #include <KWindowEffects>
 #include <KWindowSystem>
 
@@ -35,6 +37,8 @@
 #include <QAction>
 #include <QActionGroup>
 #include <QApplication>
+#include <QFileInfo>
+#include <QFutureWatcher>
 #include <QJsonArray>
 #include <QMenu>
 #include <QScopedPointer>
@@ -42,25 +46,62 @@
 #include <QQuickWindow>
 #include <QVersionNumber>
 #include <QTimer>
+#include <QtConcurrent>
 
 #include <KActivities/Consumer>
 #include <KActivities/Stats/Cleaning>
 #include <KActivities/Stats/ResultSet>
 #include <KActivities/Stats/Terms>
 
-#include <processcore/process.h>
-#include <processcore/processes.h>
-
 namespace KAStats = KActivities::Stats;
 
 using namespace KAStats;
 using namespace KAStats::Terms;
 
+// Number of desktop files whose metadata is kept around.
+static const int s_desktopEntryCacheSize = 64;
+
+// Number of recent files shown in the context menu.
+static const int s_recentDocumentCount = 5;
+
+// Age in milliseconds after which hovering a task queries its recent files again.
+static const int s_recentDocumentsMaxAge = 10000;
+
+// Number of applications whose recent files are kept around.
+static const int s_recentDocumentsCacheSize = 32;
+
+// Shared by all task managers, which all ask about the same processes.
+Q_GLOBAL_STATIC(ProcessTable, s_processTable)
+
+static QString recentDocumentsAgent(const QUrl &desktopEntryUrl)
+{
+    QString storageId = desktopEntryUrl.fileName();
+
+    if (storageId.endsWith(QLatin1String(".desktop"))) {
+        storageId = storageId.left(storageId.length() - 8);
+    }
+
+    return storageId;
+}
+
 Backend::Backend(QObject* parent) : QObject(parent)
     , m_panelWinId(0)
     , m_highlightWindows(false)
     , m_actionGroup(new QActionGroup(this))
+    , m_activitiesConsumer(new KActivities::Consumer(this))
+    , m_desktopEntries(s_desktopEntryCacheSize)
+    , m_recentDocuments(s_recentDocumentsCacheSize)
 {
+    // Installing, removing or editing applications may change their services and actions.
+    connect(KSycoca::self(), QOverload<const QStringList &>::of(&KSycoca::databaseChanged), this,
+        [this]() { m_desktopEntries.clear(); });
+
+    // Recent files are per activity.
+    connect(m_activitiesConsumer, &KActivities::Consumer::currentActivityChanged, this,
+        [this]() {
+            m_recentDocuments.clear();
+            m_recentDocumentQueries.clear();
+        });
 }
 
 Backend::~Backend()
@@ -140,6 +181,34 @@ QUrl Backend::tryDecodeApplicationsUrl(const QUrl &launcherUrl)
     return launcherUrl;
 }
 
+const Backend::DesktopEntry *Backend::desktopEntry(const QString &path) const
+{
+    if (!KDesktopFile::isDesktopFile(path)) {
+        return nullptr;
+    }
+
+    const QDateTime lastModified = QFileInfo(path).lastModified();
+
+    DesktopEntry *entry = m_desktopEntries.object(path);
+
+    if (entry && entry->lastModified == lastModified) {
+        return entry;
+    }
+
+    KDesktopFile desktopFile(path);
+
+    entry = new DesktopEntry;
+    entry->lastModified = lastModified;
+    entry->isApplication = desktopFile.hasApplicationType();
+    entry->isFileManager = desktopFile.desktopGroup().readXdgListEntry(QStringLiteral("Categories"))
+        .contains(QLatin1String("FileManager"));
+    entry->service = KService::serviceByDesktopPath(path);
+
+    m_desktopEntries.insert(path, entry);
+
+    return entry;
+}
+
 QVariantList Backend::jumpListActions(const QUrl &launcherUrl, QObject *parent)
 {
     QVariantList actions;
@@ -150,17 +219,16 @@ QVariantList Backend::jumpListActions(const QUrl &launcherUrl, QObject *parent)
 
     QUrl desktopEntryUrl = tryDecodeApplicationsUrl(launcherUrl);
 
-    if (!desktopEntryUrl.isValid() || !desktopEntryUrl.isLocalFile()
-        || !KDesktopFile::isDesktopFile(desktopEntryUrl.toLocalFile())) {
+    if (!desktopEntryUrl.isValid() || !desktopEntryUrl.isLocalFile()) {
         return actions;
     }
 
-    const KService::Ptr service = KService::serviceByDesktopPath(desktopEntryUrl.toLocalFile());
-    if (!service) {
+    const DesktopEntry *entry = desktopEntry(desktopEntryUrl.toLocalFile());
+    if (!entry || !entry->service) {
         return actions;
     }
 
-    const auto jumpListActions = service->actions();
+    const auto jumpListActions = entry->service->actions();
 
     for (const KServiceAction &serviceAction : jumpListActions) {
         if (serviceAction.noDisplay()) {
@@ -196,17 +264,19 @@ QVariantList Backend::placesActions(const QUrl &launcherUrl, bool showAllPlaces,
 
     QUrl desktopEntryUrl = tryDecodeApplicationsUrl(launcherUrl);
 
-    if (!desktopEntryUrl.isValid() || !desktopEntryUrl.isLocalFile()
-        || !KDesktopFile::isDesktopFile(desktopEntryUrl.toLocalFile())) {
+    if (!desktopEntryUrl.isValid() || !desktopEntryUrl.isLocalFile()) {
+        return QVariantList();
+    }
+
+    const DesktopEntry *entry = desktopEntry(desktopEntryUrl.toLocalFile());
+    if (!entry) {
         return QVariantList();
     }
 
     QVariantList actions;
-    KDesktopFile desktopFile(desktopEntryUrl.toLocalFile());
 
     // Since we can't have dynamic jump list actions, at least add the user's "Places" for file managers.
-    const QStringList &categories = desktopFile.desktopGroup().readXdgListEntry(QStringLiteral("Categories"));
-    if (!categories.contains(QLatin1String("FileManager"))) {
+    if (!entry->isFileManager) {
         return actions;
     }
 
@@ -299,27 +369,133 @@ QVariantList Backend::recentDocumentActions(const QUrl &launcherUrl, QObject *pa
     }
 
     QVariantList actions;
-    QString desktopName = desktopEntryUrl.fileName();
-    QString storageId = desktopName;
+    const QString storageId = recentDocumentsAgent(desktopEntryUrl);
 
-    if (storageId.endsWith(QLatin1String(".desktop"))) {
-        storageId = storageId.left(storageId.length() - 8);
+    QVector<RecentDocument> documents;
+
+    const RecentDocuments *cached = m_recentDocuments.object(storageId);
+
+    if (cached && !cached->age.hasExpired(s_recentDocumentsMaxAge)) {
+        documents = cached->documents;
+    } else {
+        // Not prefetched by hovering the task, e.g. when opened using the keyboard,
+        // or the prefetched files may be outdated by now.
+        // This runs in the GUI thread, so the query may resolve the current activity
+        // itself if the consumer does not know it yet.
+        const QString activity = m_activitiesConsumer->currentActivity();
+
+        documents = queryRecentDocuments(storageId,
+            activity.isEmpty() ? Activity::current() : Activity(activity));
+        resolveRecentDocumentIcons(documents);
+
+        cacheRecentDocuments(storageId, documents);
+
+        // A prefetch still running would only bring back older results.
+        m_recentDocumentQueries.remove(storageId);
     }
 
+    for (const RecentDocument &document : qAsConst(documents)) {
+        QAction *action = new QAction(parent);
+        action->setText(document.fileName);
+        action->setIcon(QIcon::fromTheme(document.iconName, QIcon::fromTheme(QStringLiteral("unknown"))));
+        action->setProperty("agent", storageId);
+        action->setProperty("entryPath", desktopEntryUrl);
+        action->setData(document.resource);
+        connect(action, &QAction::triggered, this, &Backend::handleRecentDocumentAction);
+
+        actions << QVariant::fromValue<QAction *>(action);
+    }
+
+    if (!documents.isEmpty()) {
+        QAction *action = new QAction(parent);
+        action->setText(i18n("Forget Recent Files"));
+        action->setIcon(QIcon::fromTheme(QStringLiteral("edit-clear-history")));
+        action->setProperty("agent", storageId);
+        connect(action, &QAction::triggered, this, &Backend::handleRecentDocumentAction);
+
+        actions << QVariant::fromValue<QAction *>(action);
+    }
+
+    return actions;
+}
+
+void Backend::prefetchRecentDocuments(const QUrl &launcherUrl)
+{
+    const QUrl desktopEntryUrl = tryDecodeApplicationsUrl(launcherUrl);
+
+    if (!desktopEntryUrl.isValid() || !desktopEntryUrl.isLocalFile()
+        || !KDesktopFile::isDesktopFile(desktopEntryUrl.toLocalFile())) {
+        return;
+    }
+
+    const QString storageId = recentDocumentsAgent(desktopEntryUrl);
+
+    if (m_recentDocumentQueries.contains(storageId)) {
+        return;
+    }
+
+    const RecentDocuments *cached = m_recentDocuments.object(storageId);
+
+    if (cached && !cached->age.hasExpired(s_recentDocumentsMaxAge)) {
+        return;
+    }
+
+    // The worker thread cannot ask for the current activity, and until the
+    // consumer knows it there is nothing meaningful to prefetch.
+    const QString activity = m_activitiesConsumer->currentActivity();
+
+    if (activity.isEmpty()) {
+        return;
+    }
+
+    m_recentDocumentQueries.insert(storageId);
+
+    auto *watcher = new QFutureWatcher<QVector<RecentDocument>>(this);
+
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, storageId]() {
+        // Discarded if the recent files were forgotten or the activity
+        // changed in the meantime.
+        if (m_recentDocumentQueries.remove(storageId)) {
+            QVector<RecentDocument> documents = watcher->result();
+            resolveRecentDocumentIcons(documents);
+
+            cacheRecentDocuments(storageId, documents);
+        }
+
+        watcher->deleteLater();
+    });
+
+    watcher->setFuture(QtConcurrent::run(&Backend::queryRecentDocuments, storageId,
+        Activity(activity)));
+}
+
+void Backend::cacheRecentDocuments(const QString &storageId, const QVector<RecentDocument> &documents)
+{
+    auto *entry = new RecentDocuments;
+    entry->documents = documents;
+    entry->age.start();
+
+    m_recentDocuments.insert(storageId, entry);
+}
+
+QVector<Backend::RecentDocument> Backend::queryRecentDocuments(const QString &agent, const Activity &activity)
+{
+    QVector<RecentDocument> documents;
+
+    // May run in a worker thread, where only an explicit activity must be passed
+    // and icons are left to resolveRecentDocumentIcons().
     auto query = UsedResources
         | RecentlyUsedFirst
-        | Agent(storageId)
+        | Agent(agent)
         | Type::any()
-        | Activity::current()
+        | activity
         | Url::file();
 
     ResultSet results(query);
 
     ResultSet::const_iterator resultIt = results.begin();
 
-    int actionCount = 0;
-
-    while (actionCount < 5 && resultIt != results.end()) {
+    while (documents.count() < s_recentDocumentCount && resultIt != results.end()) {
         const QString resource = (*resultIt).resource();
         ++resultIt;
 
@@ -329,36 +505,22 @@ QVariantList Backend::recentDocumentActions(const QUrl &launcherUrl, QObject *pa
             continue;
         }
 
-        const KFileItem fileItem(url);
-
-        if (!fileItem.isFile()) {
+        if (!QFileInfo(url.isLocalFile() ? url.toLocalFile() : url.path()).isFile()) {
             continue;
         }
 
-        QAction *action = new QAction(parent);
-        action->setText(url.fileName());
-        action->setIcon(QIcon::fromTheme(fileItem.iconName(), QIcon::fromTheme(QStringLiteral("unknown"))));
-        action->setProperty("agent", storageId);
-        action->setProperty("entryPath", desktopEntryUrl);
-        action->setData(resource);
-        connect(action, &QAction::triggered, this, &Backend::handleRecentDocumentAction);
-
-        actions << QVariant::fromValue<QAction *>(action);
-
-        ++actionCount;
+        documents.append({resource, url.fileName(), QString()});
     }
 
-    if (actionCount > 0) {
-        QAction *action = new QAction(parent);
-        action->setText(i18n("Forget Recent Files"));
-        action->setIcon(QIcon::fromTheme(QStringLiteral("edit-clear-history")));
-        action->setProperty("agent", storageId);
-        connect(action, &QAction::triggered, this, &Backend::handleRecentDocumentAction);
+    return documents;
+}
 
-        actions << QVariant::fromValue<QAction *>(action);
+void Backend::resolveRecentDocumentIcons(QVector<RecentDocument> &documents)
+{
+    // Uses the mime database and icon theme, only do this in the GUI thread.
+    for (RecentDocument &document : documents) {
+        document.iconName = KFileItem(QUrl(document.resource)).iconName();
     }
-
-    return actions;
 }
 
 void Backend::toolTipWindowChanged(QQuickWindow *window)
@@ -368,7 +530,7 @@ void Backend::toolTipWindowChanged(QQuickWindow *window)
     updateWindowHighlight();
 }
 
-void Backend::handleRecentDocumentAction() const
+void Backend::handleRecentDocumentAction()
 {
     const QAction *action = qobject_cast<QAction* >(sender());
 
@@ -394,6 +556,9 @@ void Backend::handleRecentDocumentAction() const
 
         KAStats::forgetResources(query);
 
+        m_recentDocuments.remove(agent);
+        m_recentDocumentQueries.remove(agent);
+
         return;
     }
 
@@ -503,14 +668,8 @@ bool Backend::isApplication(const QUrl &url) const
         return false;
     }
 
-    const QString &localPath = url.toLocalFile();
-
-    if (!KDesktopFile::isDesktopFile(localPath)) {
-        return false;
-    }
-
-    KDesktopFile desktopFile(localPath);
-    return desktopFile.hasApplicationType();
+    const DesktopEntry *entry = desktopEntry(url.toLocalFile());
+    return entry && entry->isApplication;
 }
 
 QList<QUrl> Backend::jsonArrayToUrlList(const QJsonArray &array) const
@@ -533,15 +692,7 @@ void Backend::cancelHighlightWindows()
 
 qint64 Backend::parentPid(qint64 pid) const
 {
-    KSysGuard::Processes procs;
-    procs.updateOrAddProcess(pid);
-
-    KSysGuard::Process *proc = procs.getProcess(pid);
-    if (!proc) {
-        return -1;
-    }
-
-    return proc->parentPid();
+    return s_processTable->parentPid(pid);
 }
 
 void Backend::windowsHovered(const QVariant &_winIds, bool hovered)
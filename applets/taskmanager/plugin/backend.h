@@ -20,8 +20,16 @@
 #ifndef BACKEND_H
 #define BACKEND_H
 
+#include <QCache>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
 #include <QRect>
+#include <QSet>
+#include <QVector>
+
+#include <KService>
 
 #include <netwm.h>
 #include <qwindowdefs.h>
@@ -34,6 +42,12 @@ class QJsonArray;
 
 namespace KActivities {
     class Consumer;
+
+    namespace Stats {
+        namespace Terms {
+            struct Activity;
+        }
+    }
 }
 
 class Backend : public QObject
@@ -75,6 +89,7 @@ class Backend : public QObject
         Q_INVOKABLE QVariantList jumpListActions(const QUrl &launcherUrl, QObject *parent);
         Q_INVOKABLE QVariantList placesActions(const QUrl &launcherUrl, bool showAllPlaces, QObject *parent);
         Q_INVOKABLE QVariantList recentDocumentActions(const QUrl &launcherUrl, QObject *parent);
+        Q_INVOKABLE void prefetchRecentDocuments(const QUrl &launcherUrl);
         Q_INVOKABLE void setActionGroup(QAction *action) const;
 
         Q_INVOKABLE QRect globalRect(QQuickItem *item) const;
@@ -108,9 +123,35 @@ class Backend : public QObject
 
     private Q_SLOTS:
         void toolTipWindowChanged(QQuickWindow *window);
-        void handleRecentDocumentAction() const;
+        void handleRecentDocumentAction();
 
     private:
+        // What the context menus need to know about a desktop file.
+        struct DesktopEntry {
+            QDateTime lastModified;
+            bool isApplication = false;
+            bool isFileManager = false;
+            KService::Ptr service;
+        };
+
+        const DesktopEntry *desktopEntry(const QString &path) const;
+
+        struct RecentDocument {
+            QString resource;
+            QString fileName;
+            QString iconName;
+        };
+
+        struct RecentDocuments {
+            QVector<RecentDocument> documents;
+            QElapsedTimer age;
+        };
+
+        static QVector<RecentDocument> queryRecentDocuments(const QString &agent,
+            const KActivities::Stats::Terms::Activity &activity);
+        static void resolveRecentDocumentIcons(QVector<RecentDocument> &documents);
+        void cacheRecentDocuments(const QString &storageId, const QVector<RecentDocument> &documents);
+
         void updateWindowHighlight();
 
         QQuickItem *m_taskManagerItem = nullptr;
@@ -121,6 +162,10 @@ class Backend : public QObject
         QList<WId> m_windowsToHighlight;
         QActionGroup *m_actionGroup = nullptr;
         KActivities::Consumer *m_activitiesConsumer = nullptr;
+        mutable QCache<QString, DesktopEntry> m_desktopEntries;
+        // Recently used files of each application, by desktop file name.
+        QCache<QString, RecentDocuments> m_recentDocuments;
+        QSet<QString> m_recentDocumentQueries;
 };
 
 #endif
@@ -0,0 +1,93 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#include "processtable.h"
+
+#include <processcore/process.h>
+#include <processcore/processes.h>
+
+// Interval in milliseconds after which expired entries are dropped, so
+// processes that exited in the meantime do not pile up.
+static const qint64 s_pruneInterval = 60000;
+
+ProcessTable::ProcessTable(int maxAge)
+    : m_processes(new KSysGuard::Processes())
+    , m_lastPrune(0)
+    , m_maxAge(maxAge)
+{
+    m_clock.start();
+}
+
+ProcessTable::~ProcessTable()
+{
+}
+
+int ProcessTable::maxAge() const
+{
+    return m_maxAge;
+}
+
+void ProcessTable::setMaxAge(int maxAge)
+{
+    m_maxAge = maxAge;
+}
+
+qint64 ProcessTable::parentPid(qint64 pid)
+{
+    const qint64 now = m_clock.elapsed();
+
+    auto it = m_parents.constFind(pid);
+
+    if (it != m_parents.constEnd() && now - it->updated < m_maxAge) {
+        return it->parentPid;
+    }
+
+    if (now - m_lastPrune >= s_pruneInterval) {
+        prune(now);
+    }
+
+    // A process that exited is not removed from m_processes, don't trust
+    // what it still has about it if it can't be read anymore.
+    KSysGuard::Process *proc = m_processes->updateOrAddProcess(pid) ? m_processes->getProcess(pid) : nullptr;
+    const qint64 parentPid = proc ? proc->parentPid() : -1;
+
+    m_parents.insert(pid, {parentPid, now});
+
+    return parentPid;
+}
+
+void ProcessTable::clear()
+{
+    m_parents.clear();
+    m_processes.reset(new KSysGuard::Processes());
+}
+
+void ProcessTable::prune(qint64 now)
+{
+    for (auto it = m_parents.begin(); it != m_parents.end(); ) {
+        if (now - it->updated >= m_maxAge) {
+            it = m_parents.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // KSysGuard keeps every process it has read, start over with the ones still in use.
+    m_processes.reset(new KSysGuard::Processes());
+
+    m_lastPrune = now;
+}
@@ -0,0 +1,67 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#ifndef PROCESSTABLE_H
+#define PROCESSTABLE_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QScopedPointer>
+
+namespace KSysGuard {
+    class Processes;
+}
+
+/**
+ * Caches the parent of processes looked up by the task manager.
+ *
+ * Looking up a process the first time, or again after maxAge()
+ * milliseconds, only reads that process (and any unknown ancestors)
+ * rather than rescanning all of them.
+ */
+class ProcessTable
+{
+    public:
+        explicit ProcessTable(int maxAge = 2000);
+        ~ProcessTable();
+
+        int maxAge() const;
+        void setMaxAge(int maxAge);
+
+        /**
+         * @return the parent of @p pid, or -1 if there is no such process.
+         */
+        qint64 parentPid(qint64 pid);
+
+        void clear();
+
+    private:
+        void prune(qint64 now);
+
+        struct Entry {
+            qint64 parentPid;
+            qint64 updated;
+        };
+
+        QScopedPointer<KSysGuard::Processes> m_processes;
+        QHash<qint64, Entry> m_parents;
+        QElapsedTimer m_clock;
+        qint64 m_lastPrune;
+        int m_maxAge;
+};
+
+#endif
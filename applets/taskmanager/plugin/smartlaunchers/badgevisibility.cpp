@@ -0,0 +1,91 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#include "badgevisibility.h"
+
+#include <QTimer>
+
+#include <limits>
+
+using namespace SmartLauncher;
+
+BadgeVisibility::BadgeVisibility(QObject *parent)
+    : QObject(parent)
+    , m_clock(&QDateTime::currentDateTimeUtc)
+    , m_expiryTimer(new QTimer(this))
+{
+    m_expiryTimer->setSingleShot(true);
+    connect(m_expiryTimer, &QTimer::timeout, this, &BadgeVisibility::update);
+}
+
+BadgeVisibility::~BadgeVisibility() = default;
+
+bool BadgeVisibility::visible() const
+{
+    return m_visible;
+}
+
+void BadgeVisibility::setBadgesEnabled(bool enabled)
+{
+    if (m_badgesEnabled != enabled) {
+        m_badgesEnabled = enabled;
+        update();
+    }
+}
+
+void BadgeVisibility::setInhibitedByApplication(bool inhibited)
+{
+    if (m_inhibitedByApplication != inhibited) {
+        m_inhibitedByApplication = inhibited;
+        update();
+    }
+}
+
+void BadgeVisibility::setInhibitedUntil(const QDateTime &until)
+{
+    if (m_inhibitedUntil != until) {
+        m_inhibitedUntil = until;
+        update();
+    }
+}
+
+void BadgeVisibility::setClock(const Clock &clock)
+{
+    m_clock = clock;
+    update();
+}
+
+void BadgeVisibility::update()
+{
+    const QDateTime now = m_clock();
+    const bool inhibitedUntil = m_inhibitedUntil.isValid() && m_inhibitedUntil > now;
+
+    m_expiryTimer->stop();
+
+    if (inhibitedUntil) {
+        // QTimer only takes an int, for longer periods we just check again once it fires
+        const qint64 remaining = now.msecsTo(m_inhibitedUntil) + 1;
+        m_expiryTimer->start(static_cast<int>(qMin<qint64>(remaining, std::numeric_limits<int>::max())));
+    }
+
+    const bool visible = m_badgesEnabled && !m_inhibitedByApplication && !inhibitedUntil;
+
+    if (m_visible != visible) {
+        m_visible = visible;
+        emit visibleChanged(visible);
+    }
+}
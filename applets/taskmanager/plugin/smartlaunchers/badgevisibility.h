@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#ifndef SMARTLAUNCHER_BADGEVISIBILITY_H
+#define SMARTLAUNCHER_BADGEVISIBILITY_H
+
+#include <QDateTime>
+#include <QObject>
+
+#include <functional>
+
+class QTimer;
+
+namespace SmartLauncher {
+
+/**
+ * Whether badges are shown at all, given the settings and do not disturb mode.
+ *
+ * The state is only re-evaluated when one of its inputs changes or when a
+ * timed do not disturb period ends, so reading it is cheap.
+ */
+class BadgeVisibility : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Clock = std::function<QDateTime()>;
+
+    explicit BadgeVisibility(QObject *parent = nullptr);
+    ~BadgeVisibility() override;
+
+    bool visible() const;
+
+    void setBadgesEnabled(bool enabled);
+    void setInhibitedByApplication(bool inhibited);
+    void setInhibitedUntil(const QDateTime &until);
+
+    // for testing, defaults to QDateTime::currentDateTimeUtc
+    void setClock(const Clock &clock);
+
+signals:
+    void visibleChanged(bool visible);
+
+private:
+    void update();
+
+    bool m_badgesEnabled = true;
+    bool m_inhibitedByApplication = false;
+    QDateTime m_inhibitedUntil;
+
+    bool m_visible = true;
+
+    Clock m_clock;
+    QTimer *m_expiryTimer;
+
+};
+
+} // namespace SmartLauncher
+
+#endif // SMARTLAUNCHER_BADGEVISIBILITY_H
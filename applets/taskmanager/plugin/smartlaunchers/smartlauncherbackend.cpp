@@ -18,17 +18,18 @@
  ***************************************************************************/
 
 #include "smartlauncherbackend.h"
+#include "badgevisibility.h"
 
 #include <QDBusConnection>
 #include <QDBusMessage>
 #include <QDBusServiceWatcher>
 #include <QDebug>
+#include <QTimer>
 
 #include <KConfigGroup>
 #include <KSharedConfig>
 #include <KService>
-
-#include <algorithm>
+#include <KSycoca>
 
 #include <notificationmanager/jobsmodel.h>
 #include <notificationmanager/settings.h>
@@ -39,34 +40,67 @@ using namespace NotificationManager;
 Backend::Backend(QObject *parent)
     : QObject(parent)
     , m_watcher(new QDBusServiceWatcher(this))
+    , m_updateTimer(new QTimer(this))
     , m_settings(new Settings(this))
+    , m_badgeVisibility(new BadgeVisibility(this))
 {
+    // Applications like chat and download clients can send lots of updates in quick succession,
+    // only apply the latest values once per event loop iteration
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->setInterval(0);
+    connect(m_updateTimer, &QTimer::timeout, this, &Backend::applyPendingUpdates);
+
+    // a launcher we couldn't find a service for might have been installed meanwhile
+    connect(KSycoca::self(), QOverload<const QStringList &>::of(&KSycoca::databaseChanged), this, [this] {
+        for (auto it = m_launcherUrlToStorageId.begin(); it != m_launcherUrlToStorageId.end();) {
+            if (it->isEmpty()) {
+                it = m_launcherUrlToStorageId.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    });
+
+    // one broadcast for all items whenever badges are shown or hidden altogether
+    connect(m_badgeVisibility, &BadgeVisibility::visibleChanged, this, [this] {
+        emit reloadRequested(QString() /*all*/);
+    });
+
     setupUnity();
 
     reload();
     connect(m_settings, &Settings::settingsChanged, this, &Backend::reload);
+    connect(m_settings, &Settings::notificationsInhibitedByApplicationChanged, this, &Backend::updateBadgeVisibility);
 }
 
 Backend::~Backend() = default;
 
 void Backend::reload()
 {
-    m_badgeBlacklist = m_settings->badgeBlacklistedApplications();
+    m_badgeBlacklist.clear();
 
     // Unity Launcher API operates on storage IDs ("foo.desktop"), whereas settings return desktop entries "foo"
-    std::transform(m_badgeBlacklist.begin(), m_badgeBlacklist.end(), m_badgeBlacklist.begin(), [](const QString &desktopEntry) -> QString {
-        return desktopEntry + QStringLiteral(".desktop");
-    });
+    const QStringList badgeBlacklist = m_settings->badgeBlacklistedApplications();
+    for (const QString &desktopEntry : badgeBlacklist) {
+        m_badgeBlacklist.insert(desktopEntry + QStringLiteral(".desktop"));
+    }
+
+    {
+        // we're about to reload all items anyway
+        const QSignalBlocker blocker(m_badgeVisibility);
+        updateBadgeVisibility();
+    }
 
     setupApplicationJobs();
 
     emit reloadRequested(QString() /*all*/);
 }
 
-bool Backend::doNotDisturbMode() const
+void Backend::updateBadgeVisibility()
 {
-    return m_settings->notificationsInhibitedByApplication()
-            || (m_settings->notificationsInhibitedUntil().isValid() && m_settings->notificationsInhibitedUntil() > QDateTime::currentDateTimeUtc());
+    m_badgeVisibility->setBadgesEnabled(m_settings->badgesInTaskManager());
+    m_badgeVisibility->setInhibitedByApplication(m_settings->notificationsInhibitedByApplication());
+    m_badgeVisibility->setInhibitedUntil(m_settings->notificationsInhibitedUntil());
 }
 
 void Backend::setupUnity()
@@ -118,9 +152,7 @@ bool Backend::hasLauncher(const QString &storageId) const
 
 int Backend::count(const QString &uri) const
 {
-    if (!m_settings->badgesInTaskManager()
-            || doNotDisturbMode()
-            || m_badgeBlacklist.contains(uri)) {
+    if (!m_badgeVisibility->visible() || m_badgeBlacklist.contains(uri)) {
         return 0;
     }
     return m_launchers.value(uri).count;
@@ -128,9 +160,7 @@ int Backend::count(const QString &uri) const
 
 bool Backend::countVisible(const QString &uri) const
 {
-    if (!m_settings->badgesInTaskManager()
-            || doNotDisturbMode()
-            || m_badgeBlacklist.contains(uri)) {
+    if (!m_badgeVisibility->visible() || m_badgeBlacklist.contains(uri)) {
         return false;
     }
     return m_launchers.value(uri).countVisible;
@@ -182,6 +212,8 @@ void Backend::update(const QString &uri, const QMap<QString, QVariant> &properti
         KService::Ptr service = KService::serviceByStorageId(normalizedUri);
         if (!service) {
             qWarning() << "Failed to find service for Unity Launcher" << uri;
+            // remember it so we don't look it up again for every update it sends
+            m_launcherUrlToStorageId.insert(uri, QString());
             return;
         }
 
@@ -194,6 +226,32 @@ void Backend::update(const QString &uri, const QMap<QString, QVariant> &properti
         storageId = *foundStorageId;
     }
 
+    if (storageId.isEmpty()) {
+        return;
+    }
+
+    QVariantMap &pendingProperties = m_pendingUpdates[storageId];
+    for (auto it = properties.constBegin(), end = properties.constEnd(); it != end; ++it) {
+        pendingProperties.insert(it.key(), it.value());
+    }
+
+    if (!m_updateTimer->isActive()) {
+        m_updateTimer->start();
+    }
+}
+
+void Backend::applyPendingUpdates()
+{
+    const QHash<QString, QVariantMap> pendingUpdates = m_pendingUpdates;
+    m_pendingUpdates.clear();
+
+    for (auto it = pendingUpdates.constBegin(), end = pendingUpdates.constEnd(); it != end; ++it) {
+        applyUpdate(it.key(), it.value());
+    }
+}
+
+void Backend::applyUpdate(const QString &storageId, const QVariantMap &properties)
+{
     auto foundEntry = m_launchers.find(storageId);
     if (foundEntry == m_launchers.end()) { // we don't have it yet, create a new Entry
         Entry entry;
@@ -249,6 +307,7 @@ void Backend::onServiceUnregistered(const QString &service)
         return;
     }
 
+    m_pendingUpdates.remove(storageId);
     m_launchers.remove(storageId);
     emit launcherRemoved(storageId);
 }
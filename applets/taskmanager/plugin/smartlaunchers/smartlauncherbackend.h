@@ -23,12 +23,14 @@
 #include <QObject>
 #include <QDBusContext>
 #include <QHash>
+#include <QSet>
 #include <QVariantMap>
 
 #include <notificationmanager/jobsmodel.h>
 
 class QDBusServiceWatcher;
 class QString;
+class QTimer;
 
 namespace NotificationManager
 {
@@ -37,6 +39,8 @@ class Settings;
 
 namespace SmartLauncher {
 
+class BadgeVisibility;
+
 struct Entry
 {
     int count = 0;
@@ -78,6 +82,9 @@ private slots:
     void update(const QString &uri, const QMap<QString, QVariant> &properties);
 
 private:
+    void applyPendingUpdates();
+    void applyUpdate(const QString &storageId, const QVariantMap &properties);
+
     void reload();
     void setupUnity();
     void setupApplicationJobs();
@@ -109,12 +116,16 @@ private:
         }
     }
 
-    bool doNotDisturbMode() const;
+    void updateBadgeVisibility();
 
     // Unity Launchers
     QDBusServiceWatcher *m_watcher;
     QHash<QString, QString> m_dbusServiceToLauncherUrl;
+    // an empty storage id means no service could be found for this launcher url
     QHash<QString, QString> m_launcherUrlToStorageId;
+    // properties received since the last event loop iteration, merged per storage id
+    QHash<QString, QVariantMap> m_pendingUpdates;
+    QTimer *m_updateTimer;
     // these rules can be configured in the taskmanagerrulesrc in the "Unity Launcher Mapping" section
     // key is the actual desktop file name of the application (some-broken-app-beta.desktop)
     // vaue is how it actually announces itself on the Unity API (some-broken-app.desktop)
@@ -127,7 +138,8 @@ private:
 
     QHash<QString, Entry> m_launchers;
 
-    QStringList m_badgeBlacklist;
+    BadgeVisibility *m_badgeVisibility;
+    QSet<QString> m_badgeBlacklist;
 
     bool m_available = false;
 
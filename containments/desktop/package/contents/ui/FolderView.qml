@@ -809,8 +809,36 @@ FocusScope {
                     var midHeight = gridView.cellHeight / 2;
                     var indices = [];
 
-                    for (var s = 0; s < stripes; s++) {
-                        for (var i = 0; i < perStripe; i++) {
+                    // Only visit the grid cells the rubberband covers. Horizontal
+                    // cell coordinates are mirrored in right-to-left layouts, so
+                    // only the vertical range is used there.
+                    var cells = main.rubberBand.intersectedCells(Qt.size(gridView.cellWidth, gridView.cellHeight));
+                    var ltr = (gridView.effectiveLayoutDirection != Qt.RightToLeft);
+                    var firstStripe = 0;
+                    var lastStripe = stripes - 1;
+                    var firstInStripe = 0;
+                    var lastInStripe = perStripe - 1;
+
+                    if (rows) {
+                        firstStripe = Math.max(firstStripe, cells.y);
+                        lastStripe = Math.min(lastStripe, cells.y + cells.height - 1);
+
+                        if (ltr) {
+                            firstInStripe = Math.max(firstInStripe, cells.x);
+                            lastInStripe = Math.min(lastInStripe, cells.x + cells.width - 1);
+                        }
+                    } else {
+                        firstInStripe = Math.max(firstInStripe, cells.y);
+                        lastInStripe = Math.min(lastInStripe, cells.y + cells.height - 1);
+
+                        if (ltr) {
+                            firstStripe = Math.max(firstStripe, cells.x);
+                            lastStripe = Math.min(lastStripe, cells.x + cells.width - 1);
+                        }
+                    }
+
+                    for (var s = firstStripe; s <= lastStripe; s++) {
+                        for (var i = firstInStripe; i <= lastInStripe; i++) {
                             var index = (s * perStripe) + i;
 
                             if (index >= gridView.count) {
@@ -1213,7 +1241,11 @@ FocusScope {
             adapterView: gridView
             adapterModel: positioner
             adapterIconSize: gridView.iconSize * 2
-            adapterVisibleArea: Qt.rect(gridView.contentX, gridView.contentY, gridView.contentWidth, gridView.contentHeight)
+            adapterVisibleArea: Qt.rect(gridView.contentX - gridView.originX, gridView.contentY - gridView.originY,
+                gridView.width, gridView.height)
+            adapterCellSize: Qt.size(gridView.cellWidth, gridView.cellHeight)
+            adapterFlow: (gridView.flow == GridView.FlowLeftToRight)
+                ? Folder.ItemViewAdapter.LeftToRight : Folder.ItemViewAdapter.TopToBottom
 
             Component.onCompleted: {
                 gridView.movementStarted.connect(viewAdapter.viewScrolled);
@@ -0,0 +1,215 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#include "foldermodelbenchmark.h"
+#include "foldermodel.h"
+#include "positioner.h"
+#include "testfolder.h"
+
+#include <KDirModel>
+
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+QTEST_MAIN(FolderModelBenchmark)
+
+static const int listingTimeout = 120000;
+
+void FolderModelBenchmark::initTestCase()
+{
+    // Also print the timing spans the model logs for each stage.
+    QLoggingCategory::setFilterRules(QStringLiteral("plasma.containments.desktop.folder.timing.debug=true"));
+}
+
+void FolderModelBenchmark::cleanupTestCase()
+{
+    qDeleteAll(m_folders);
+    m_folders.clear();
+}
+
+void FolderModelBenchmark::addSizes()
+{
+    QTest::addColumn<int>("fileCount");
+
+    QTest::newRow("1k") << 1000;
+
+    // Creating and listing these takes minutes, only run them when asked to.
+    if (qEnvironmentVariableIsSet("FOLDERMODELBENCHMARK_LARGE")) {
+        QTest::newRow("10k") << 10000;
+        QTest::newRow("50k") << 50000;
+    }
+}
+
+QString FolderModelBenchmark::folder(int fileCount)
+{
+    QTemporaryDir *dir = m_folders.value(fileCount);
+
+    if (!dir) {
+        dir = new QTemporaryDir();
+        m_folders.insert(fileCount, dir);
+        TestFolder::populate(dir->path(), fileCount, TestFolder::MixedDesktop);
+    }
+
+    return dir->path();
+}
+
+void FolderModelBenchmark::benchmarkFirstRow_data()
+{
+    addSizes();
+}
+
+void FolderModelBenchmark::benchmarkFirstRow()
+{
+    QFETCH(int, fileCount);
+    const QString path = folder(fileCount);
+
+    FolderModel folderModel;
+    folderModel.classBegin();
+    folderModel.setSortMode(KDirModel::Name);
+    folderModel.componentComplete();
+
+    QSignalSpy s(&folderModel, &QAbstractItemModel::rowsInserted);
+    QElapsedTimer timer;
+    timer.start();
+    folderModel.setUrl(path);
+    QVERIFY(s.wait(listingTimeout));
+
+    QTest::setBenchmarkResult(timer.elapsed(), QTest::WalltimeMilliseconds);
+}
+
+void FolderModelBenchmark::benchmarkListing_data()
+{
+    addSizes();
+}
+
+void FolderModelBenchmark::benchmarkListing()
+{
+    QFETCH(int, fileCount);
+    const QString path = folder(fileCount);
+
+    FolderModel folderModel;
+    folderModel.classBegin();
+    folderModel.setSortMode(KDirModel::Name);
+    folderModel.componentComplete();
+
+    QSignalSpy s(&folderModel, &FolderModel::listingCompleted);
+    QElapsedTimer timer;
+    timer.start();
+    folderModel.setUrl(path);
+    QVERIFY(s.wait(listingTimeout));
+    const qint64 completed = timer.elapsed();
+
+    QCOMPARE(folderModel.rowCount(), fileCount);
+    QTest::setBenchmarkResult(completed, QTest::WalltimeMilliseconds);
+}
+
+void FolderModelBenchmark::benchmarkSort_data()
+{
+    addSizes();
+}
+
+void FolderModelBenchmark::benchmarkSort()
+{
+    QFETCH(int, fileCount);
+    const QString path = folder(fileCount);
+
+    FolderModel folderModel;
+    folderModel.classBegin();
+    folderModel.setSortMode(KDirModel::Name);
+    folderModel.setUrl(path);
+    folderModel.componentComplete();
+    QSignalSpy s(&folderModel, &FolderModel::listingCompleted);
+    QVERIFY(s.wait(listingTimeout));
+
+    bool desc = false;
+
+    QBENCHMARK {
+        desc = !desc;
+        folderModel.setSortDesc(desc);
+    }
+
+    QCOMPARE(folderModel.rowCount(), fileCount);
+}
+
+void FolderModelBenchmark::benchmarkFilter_data()
+{
+    addSizes();
+}
+
+void FolderModelBenchmark::benchmarkFilter()
+{
+    QFETCH(int, fileCount);
+    const QString path = folder(fileCount);
+
+    FolderModel folderModel;
+    folderModel.classBegin();
+    folderModel.setUrl(path);
+    folderModel.setFilterMode(FolderModel::FilterShowMatches);
+    folderModel.componentComplete();
+    QSignalSpy s(&folderModel, &FolderModel::listingCompleted);
+    QVERIFY(s.wait(listingTimeout));
+
+    bool links = false;
+
+    QBENCHMARK {
+        links = !links;
+        folderModel.setFilterPattern(links ? QStringLiteral("*.desktop") : QStringLiteral("*.txt"));
+    }
+
+    QVERIFY(folderModel.rowCount() > 0);
+    QVERIFY(folderModel.rowCount() < fileCount);
+}
+
+void FolderModelBenchmark::benchmarkApplyPositions_data()
+{
+    addSizes();
+}
+
+void FolderModelBenchmark::benchmarkApplyPositions()
+{
+    QFETCH(int, fileCount);
+    const QString path = folder(fileCount);
+    const int perStripe = 50;
+
+    FolderModel folderModel;
+    folderModel.classBegin();
+    folderModel.componentComplete();
+    Positioner positioner;
+    positioner.setEnabled(true);
+    positioner.setFolderModel(&folderModel);
+    positioner.setPerStripe(perStripe);
+
+    folderModel.setUrl(path);
+    QSignalSpy s(&folderModel, &FolderModel::listingCompleted);
+    QVERIFY(s.wait(listingTimeout));
+    QCOMPARE(folderModel.rowCount(), fileCount);
+
+    const QStringList positions = TestFolder::reversedPositions(&folderModel, perStripe);
+
+    QBENCHMARK {
+        positioner.setPositions(QStringList());
+        positioner.setPositions(positions);
+    }
+
+    // The last item went to the top left, the second stripe stays empty.
+    const auto lastUrl = folderModel.index(fileCount - 1, 0).data(FolderModel::UrlRole).toUrl();
+    QCOMPARE(positioner.indexForUrl(lastUrl), 0);
+    QCOMPARE(positioner.map(perStripe), -1);
+}
@@ -22,6 +22,9 @@
 #include "foldermodeltest.h"
 #include "foldermodel.h"
 #include "screenmapper.h"
+#include "testfolder.h"
+
+#include <KDirModel>
 
 #include <QTest>
 #include <QTemporaryDir>
@@ -128,6 +131,38 @@ void FolderModelTest::tst_filterListing()
     }
 }
 
+void FolderModelTest::tst_filterPatterns_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<int>("filterMode");
+    QTest::addColumn<QStringList>("result");
+    QTest::newRow("Suffix") << "*.TXT" << (int)FolderModel::FilterShowMatches
+                            << QStringList{"file1.txt", "file2.txt", "file3.txt", "file4.txt", "file5.txt",
+                                           "file6.txt", "file7.txt", "file8.txt", "file9.txt"};
+    QTest::newRow("Mixed") << "FILE1.* *2.txt ?ile3.txt" << (int)FolderModel::FilterShowMatches
+                           << QStringList{"file1.txt", "file2.txt", "file3.txt"};
+    QTest::newRow("Hide") << "*.txt file[1-8]*" << (int)FolderModel::FilterHideMatches
+                          << QStringList{"firstDir"};
+    QTest::newRow("No match") << "*.pdf" << (int)FolderModel::FilterShowMatches << QStringList{};
+}
+
+void FolderModelTest::tst_filterPatterns()
+{
+    QFETCH(QString, pattern);
+    QFETCH(int, filterMode);
+    QFETCH(QStringList, result);
+
+    m_folderModel->setFilterPattern(pattern);
+    m_folderModel->setFilterMimeTypes({"all/all"});
+    m_folderModel->setFilterMode(filterMode);
+
+    QStringList names;
+    for (int i = 0; i < m_folderModel->rowCount(); i++) {
+        names << m_folderModel->index(i, 0).data(FolderModel::FileNameRole).toString();
+    }
+    QCOMPARE(names, result);
+}
+
 void FolderModelTest::tst_cd()
 {
     QSignalSpy s(m_folderModel, &FolderModel::listingCompleted);
@@ -215,6 +250,18 @@ void FolderModelTest::tst_selection()
             QVERIFY(m_folderModel->isSelected(i));
         }
     }
+
+    // rows may come unsorted and with duplicates from the rubber band
+    m_folderModel->updateSelection({8, 2, 3, 2}, false);
+    for (int i = 0; i < 10; i++) {
+        QCOMPARE(m_folderModel->isSelected(i), i == 2 || i == 3 || i == 8);
+    }
+
+    // same rubber band state again after the selection changed elsewhere
+    m_folderModel->clearSelection();
+    m_folderModel->updateSelection({8, 2, 3, 2}, false);
+    QVERIFY(m_folderModel->isSelected(2));
+    QVERIFY(m_folderModel->isSelected(8));
 }
 
 void FolderModelTest::tst_defaultValues()
@@ -381,3 +428,35 @@ void FolderModelTest::tst_multiScreenDifferenPath()
     QCOMPARE(secondFolderModel.rowCount(), count2 + 1);
 }
 
+
+void FolderModelTest::tst_sortLargeFolder()
+{
+    const int fileCount = 10000;
+    const QLatin1String large(QLatin1String("Large"));
+
+    QDir dir(m_folderDir->path());
+    dir.mkdir(large);
+    dir.cd(large);
+    TestFolder::populate(dir.path(), fileCount);
+
+    FolderModel folderModel;
+    folderModel.classBegin();
+    folderModel.setUrl(dir.path());
+    folderModel.componentComplete();
+    QSignalSpy s(&folderModel, &FolderModel::listingCompleted);
+    QVERIFY(s.wait(30000));
+    QCOMPARE(folderModel.rowCount(), fileCount);
+
+    folderModel.setSortDesc(true);
+
+    QCOMPARE(folderModel.index(0, 0).data(FolderModel::FileNameRole).toString(),
+             QStringLiteral("file%1.txt").arg(fileCount - 1, 5, 10, QLatin1Char('0')));
+    QCOMPARE(folderModel.index(fileCount - 1, 0).data(FolderModel::FileNameRole).toString(),
+             QStringLiteral("file00000.txt"));
+
+    folderModel.setSortMode(KDirModel::Size);
+    folderModel.setSortMode(KDirModel::Name);
+
+    QCOMPARE(folderModel.index(0, 0).data(FolderModel::FileNameRole).toString(),
+             QStringLiteral("file%1.txt").arg(fileCount - 1, 5, 10, QLatin1Char('0')));
+}
@@ -38,6 +38,8 @@ private Q_SLOTS:
     void tst_listingDescending();
     void tst_listingFolderNotFirst();
     void tst_filterListing();
+    void tst_filterPatterns_data();
+    void tst_filterPatterns();
     void tst_cd();
     void tst_rename_data();
     void tst_rename();
@@ -47,6 +49,7 @@ private Q_SLOTS:
     void tst_lockedChanged();
     void tst_multiScreen();
     void tst_multiScreenDifferenPath();
+    void tst_sortLargeFolder();
 
 
 private:    
@@ -149,6 +149,17 @@ void PositionerTest::tst_nearestitem()
     }
 }
 
+void PositionerTest::tst_nearestitemSparse()
+{
+    // move the last item one stripe further, leaving a gap
+    m_positioner->move({9, 14});
+    QCOMPARE(m_positioner->nearestItem(14, Qt::UpArrow), 8);
+    QCOMPARE(m_positioner->nearestItem(14, Qt::LeftArrow), 7);
+    QCOMPARE(m_positioner->nearestItem(14, Qt::RightArrow), -1);
+    QCOMPARE(m_positioner->nearestItem(6, Qt::DownArrow), 14);
+    QCOMPARE(m_positioner->nearestItem(8, Qt::DownArrow), 14);
+}
+
 void PositionerTest::tst_isBlank()
 {
     QCOMPARE(m_positioner->isBlank(0), false);
@@ -305,12 +316,84 @@ void PositionerTest::tst_proxyMapping()
     verifyMapping(secondPositioner.sourceToProxyMapping(), expectedSource2ProxyScreen1);
 }
 
+void PositionerTest::tst_indexForUrl()
+{
+    const auto count = m_folderModel->rowCount();
+    for (int i = 0; i < count; i++) {
+        const auto url = m_folderModel->index(i, 0).data(FolderModel::UrlRole).toUrl();
+        QCOMPARE(m_positioner->indexForUrl(url), i);
+    }
+
+    const auto firstUrl = m_folderModel->index(0, 0).data(FolderModel::UrlRole).toUrl();
+    m_positioner->move({0, 10});
+    QCOMPARE(m_positioner->indexForUrl(firstUrl), 10);
+
+    // a new item is picked up by the index
+    QDir dir(m_folderDir->path());
+    dir.cd(desktop);
+    QFile f(dir.filePath(QStringLiteral("file10.txt")));
+    f.open(QFile::WriteOnly);
+    f.close();
+    QSignalSpy s(m_folderModel, &QAbstractItemModel::rowsInserted);
+    QVERIFY(s.wait(1000));
+    const auto newRow = m_positioner->indexForUrl(QUrl::fromLocalFile(f.fileName()));
+    QVERIFY(newRow != -1);
+    QCOMPARE(m_positioner->data(m_positioner->index(newRow, 0), FolderModel::FileNameRole).toString(),
+             QStringLiteral("file10.txt"));
+
+    QVERIFY(f.remove());
+    QSignalSpy s2(m_folderModel, &QAbstractItemModel::rowsRemoved);
+    QVERIFY(s2.wait(1000));
+    QCOMPARE(m_positioner->indexForUrl(QUrl::fromLocalFile(f.fileName())), -1);
+    QCOMPARE(m_positioner->indexForUrl(firstUrl), 10);
+}
+
+void PositionerTest::tst_legacyPositions()
+{
+    // three strings per item, as written by earlier versions
+    const auto count = m_folderModel->rowCount();
+    QStringList legacy{QString::number(1 + ((count - 1) / 3)), QStringLiteral("3")};
+    for (int i = 0; i < count; i++) {
+        const int row = count - 1 - i;
+        legacy << m_folderModel->index(i, 0).data(FolderModel::UrlRole).toString()
+               << QString::number(row / 3) << QString::number(row % 3);
+    }
+
+    m_positioner->setPositions(legacy);
+    for (int i = 0; i < count; i++) {
+        QCOMPARE(m_positioner->map(i), count - 1 - i);
+    }
+
+    // it is written back in the compact format and round-trips
+    QSignalSpy s(m_positioner, &Positioner::positionsChanged);
+    QVERIFY(s.wait(500));
+    const auto compact = m_positioner->positions();
+    QCOMPARE(compact.count(), 2);
+    const auto expanded = Positioner::expandPositions(compact);
+    QCOMPARE(expanded.count(), legacy.count());
+    QCOMPARE(expanded.mid(0, 2), legacy.mid(0, 2));
+    QCOMPARE(QSet<QString>(expanded.constBegin(), expanded.constEnd()),
+             QSet<QString>(legacy.constBegin(), legacy.constEnd()));
+
+    m_positioner->reset();
+    m_positioner->setPositions(compact);
+    for (int i = 0; i < count; i++) {
+        QCOMPARE(m_positioner->map(i), count - 1 - i);
+    }
+
+    // garbage is ignored
+    m_positioner->setPositions({QStringLiteral("compact:1"), QStringLiteral("!!!")});
+    QCOMPARE(m_positioner->rowCount(), count);
+}
+
 void PositionerTest::checkPositions(int perStripe)
 {
     QSignalSpy s(m_positioner, &Positioner::positionsChanged);
     s.wait(500);
 
-    const auto positions = m_positioner->positions();
+    // compact format, a header and the encoded positions
+    QCOMPARE(m_positioner->positions().count(), 2);
+    const auto positions = Positioner::expandPositions(m_positioner->positions());
     struct Pos {
         int x;
         int y;
@@ -47,12 +47,15 @@ private Q_SLOTS:
     void tst_move();
     void tst_nearestitem_data();
     void tst_nearestitem();
+    void tst_nearestitemSparse();
     void tst_isBlank();
     void tst_reset();
     void tst_defaultValues();
     void tst_changeEnabledStatus();
     void tst_changePerStripe();
     void tst_proxyMapping();
+    void tst_indexForUrl();
+    void tst_legacyPositions();
 
 private:
     void checkPositions(int perStripe);
@@ -25,9 +25,22 @@
 
 #include <QTest>
 #include <QSignalSpy>
+#include <QTemporaryDir>
+
+#include <KConfig>
+#include <KConfigGroup>
 
 QTEST_MAIN(ScreenMapperTest)
 
+static QMap<QString, QString> mappingOf(const QStringList &mapping)
+{
+    // screenMapping() is in hash order
+    QMap<QString, QString> result;
+    for (int i = 0; i + 1 < mapping.count(); i += 2)
+        result.insert(mapping.at(i), mapping.at(i + 1));
+    return result;
+}
+
 void ScreenMapperTest::initTestCase()
 {
     m_screenMapper = ScreenMapper::instance();
@@ -87,6 +100,30 @@ void ScreenMapperTest::tst_addMapping()
     }
 }
 
+void ScreenMapperTest::tst_addMappingUnchanged()
+{
+    const auto path = ScreenMapper::stringToUrl(QStringLiteral("desktop:/"));
+    addScreens(path);
+    QSignalSpy s(m_screenMapper, &ScreenMapper::screenMappingChanged);
+    const QUrl url = ScreenMapper::stringToUrl(QStringLiteral("desktop:/foo.txt"));
+
+    m_screenMapper->addMapping(url, 1);
+    QCOMPARE(s.count(), 1);
+    m_screenMapper->addMapping(url, 1);
+    QCOMPARE(s.count(), 1);
+    m_screenMapper->addMapping(url, 2);
+    QCOMPARE(s.count(), 2);
+
+    // delayed changes are batched into a single signal
+    for (int i = 0; i < 3; i++) {
+        m_screenMapper->addMapping(url, i, ScreenMapper::DelayedSignal);
+    }
+    m_screenMapper->removeFromMap(url);
+    QVERIFY(s.wait());
+    QCOMPARE(s.count(), 3);
+    QCOMPARE(m_screenMapper->screenForItem(url), -1);
+}
+
 void ScreenMapperTest::tst_addRemoveScreenWithItems()
 {
     const auto path = ScreenMapper::stringToUrl(QStringLiteral("desktop:/"));
@@ -151,9 +188,127 @@ void ScreenMapperTest::tst_addRemoveScreenDifferentPaths()
 
 }
 
+void ScreenMapperTest::tst_removeItemFromDisabledScreen()
+{
+    const auto path = ScreenMapper::stringToUrl(QStringLiteral("desktop:/"));
+    addScreens(path);
+    QString file("desktop:/foo%1.txt");
+
+    for (int i = 0 ; i < 3; i++) {
+        m_screenMapper->addMapping(ScreenMapper::stringToUrl(file.arg(i)), 1);
+    }
+
+    m_screenMapper->removeScreen(1, path);
+    // the item was dropped on another screen meanwhile
+    const QUrl movedItem = ScreenMapper::stringToUrl(file.arg(1));
+    m_screenMapper->addMapping(movedItem, 0);
+    m_screenMapper->removeItemFromDisabledScreen(movedItem);
+    // removing it twice or removing an unknown item is harmless
+    m_screenMapper->removeItemFromDisabledScreen(movedItem);
+    m_screenMapper->removeItemFromDisabledScreen(ScreenMapper::stringToUrl(QStringLiteral("desktop:/bar.txt")));
+
+    m_screenMapper->addScreen(1, path);
+    QCOMPARE(m_screenMapper->screenForItem(ScreenMapper::stringToUrl(file.arg(0))), 1);
+    QCOMPARE(m_screenMapper->screenForItem(movedItem), 0);
+    QCOMPARE(m_screenMapper->screenForItem(ScreenMapper::stringToUrl(file.arg(2))), 1);
+}
+
 void ScreenMapperTest::addScreens(const QUrl &path)
 {
     m_screenMapper->addScreen(0, path);
     m_screenMapper->addScreen(1, path);
     m_screenMapper->addScreen(2, path);
 }
+
+void ScreenMapperTest::tst_configLegacyMapping()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("screenmappertestrc"));
+
+    const QStringList legacy{QStringLiteral("desktop:/foo.txt"), QStringLiteral("0"),
+                             QStringLiteral("desktop:/Bar/baz.txt"), QStringLiteral("1"),
+                             QStringLiteral("file:///tmp/other file.txt"), QStringLiteral("0")};
+    {
+        KConfig config(path, KConfig::SimpleConfig);
+        KConfigGroup group(&config, QStringLiteral("ScreenMapping"));
+        group.writeEntry(QStringLiteral("screenMapping"), legacy);
+
+        m_screenMapper->readConfig(group);
+        QCOMPARE(mappingOf(m_screenMapper->screenMapping()), mappingOf(legacy));
+
+        // every converted item is written in the new format
+        m_screenMapper->writeConfig(group);
+        QCOMPARE(group.group(QStringLiteral("Items")).keyList().count(), 3);
+        QCOMPARE(group.readEntry(QStringLiteral("screenMappingPrefixes"), QStringList()).count(), 3);
+        // and the legacy entry is kept for older versions
+        QCOMPARE(group.readEntry(QStringLiteral("screenMapping"), QStringList()), legacy);
+        QVERIFY(config.sync());
+    }
+
+    m_screenMapper->cleanup();
+
+    KConfig config(path, KConfig::SimpleConfig);
+    const KConfigGroup group(&config, QStringLiteral("ScreenMapping"));
+    m_screenMapper->readConfig(group);
+    QCOMPARE(mappingOf(m_screenMapper->screenMapping()), mappingOf(legacy));
+}
+
+void ScreenMapperTest::tst_configOnlyDirtyEntries()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    KConfig config(dir.filePath(QStringLiteral("screenmappertestrc")), KConfig::SimpleConfig);
+    KConfigGroup group(&config, QStringLiteral("ScreenMapping"));
+
+    const QUrl foo = ScreenMapper::stringToUrl(QStringLiteral("desktop:/foo.txt"));
+    const QUrl bar = ScreenMapper::stringToUrl(QStringLiteral("desktop:/bar.txt"));
+    m_screenMapper->addMapping(foo, 0);
+    m_screenMapper->addMapping(bar, 1);
+    m_screenMapper->writeConfig(group);
+
+    // mark the stored entries, an entry that is written again loses its mark
+    KConfigGroup items = group.group(QStringLiteral("Items"));
+    const QStringList keys = items.keyList();
+    QCOMPARE(keys.count(), 2);
+    for (const QString &key : keys)
+        items.writeEntry(key, 42);
+
+    m_screenMapper->addMapping(bar, 2);
+    m_screenMapper->writeConfig(group);
+
+    m_screenMapper->cleanup();
+    m_screenMapper->readConfig(group);
+    const QMap<QString, QString> expected{{foo.toString(), QStringLiteral("42")},
+                                          {bar.toString(), QStringLiteral("2")}};
+    QCOMPARE(mappingOf(m_screenMapper->screenMapping()), expected);
+}
+
+void ScreenMapperTest::tst_configPrunePrefixes()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    KConfig config(dir.filePath(QStringLiteral("screenmappertestrc")), KConfig::SimpleConfig);
+    KConfigGroup group(&config, QStringLiteral("ScreenMapping"));
+
+    const QUrl foo = ScreenMapper::stringToUrl(QStringLiteral("desktop:/foo.txt"));
+    const QUrl baz = ScreenMapper::stringToUrl(QStringLiteral("desktop:/Bar/baz.txt"));
+    m_screenMapper->addMapping(foo, 0);
+    m_screenMapper->addMapping(baz, 1);
+    m_screenMapper->writeConfig(group);
+    QCOMPARE(group.readEntry(QStringLiteral("screenMappingPrefixes"), QStringList()).count(), 2);
+
+    // the last item in desktop:/Bar/ is gone, so is its prefix
+    m_screenMapper->removeFromMap(baz);
+    m_screenMapper->writeConfig(group);
+    QCOMPARE(group.readEntry(QStringLiteral("screenMappingPrefixes"), QStringList()),
+             QStringList{QStringLiteral("desktop:/")});
+    QCOMPARE(group.group(QStringLiteral("Items")).keyList().count(), 1);
+
+    m_screenMapper->cleanup();
+    m_screenMapper->readConfig(group);
+    const QMap<QString, QString> expected{{foo.toString(), QStringLiteral("0")}};
+    QCOMPARE(mappingOf(m_screenMapper->screenMapping()), expected);
+}
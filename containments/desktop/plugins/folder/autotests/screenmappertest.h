@@ -38,8 +38,13 @@ private Q_SLOTS:
     void tst_addScreens();
     void tst_removeScreens();
     void tst_addMapping();
+    void tst_addMappingUnchanged();
     void tst_addRemoveScreenWithItems();
     void tst_addRemoveScreenDifferentPaths();
+    void tst_removeItemFromDisabledScreen();
+    void tst_configLegacyMapping();
+    void tst_configOnlyDirtyEntries();
+    void tst_configPrunePrefixes();
 
 private:
     void addScreens(const QUrl &path);
@@ -0,0 +1,87 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#ifndef TESTFOLDER_H
+#define TESTFOLDER_H
+
+#include <QAbstractItemModel>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+
+#include "foldermodel.h"
+
+// Synthetic folder contents and icon positions shared by the folder autotests.
+namespace TestFolder
+{
+
+enum Content {
+    // file00000.txt, file00001.txt, ...
+    PlainFiles,
+    // Every tenth item is a .desktop link and every fiftieth a folder,
+    // roughly what a cluttered desktop looks like.
+    MixedDesktop
+};
+
+inline void populate(const QString &path, int fileCount, Content content = PlainFiles)
+{
+    const int desktopFileInterval = 10;
+    const int folderInterval = 50;
+
+    QDir root(path);
+    QFile f;
+
+    for (int i = 0; i < fileCount; i++) {
+        const QString number = QStringLiteral("%1").arg(i, 5, 10, QLatin1Char('0'));
+
+        if (content == MixedDesktop && i % folderInterval == 0) {
+            root.mkdir(QStringLiteral("folder") + number);
+        } else if (content == MixedDesktop && i % desktopFileInterval == 0) {
+            f.setFileName(QStringLiteral("%1/link%2.desktop").arg(path, number));
+            f.open(QFile::WriteOnly);
+            f.write(QStringLiteral("[Desktop Entry]\nType=Link\nName=Link %1\nURL=file://%2/folder%3\n")
+                .arg(i).arg(path).arg(i - i % folderInterval, 5, 10, QLatin1Char('0')).toUtf8());
+            f.close();
+        } else {
+            f.setFileName(QStringLiteral("%1/file%2.txt").arg(path, number));
+            f.open(QFile::WriteOnly);
+            f.write(QByteArray::number(i));
+            f.close();
+        }
+    }
+}
+
+// Positions that place the icons of model in reverse order, leaving every
+// other stripe empty, in the legacy format Positioner::setPositions accepts.
+inline QStringList reversedPositions(const QAbstractItemModel *model, int perStripe)
+{
+    const int count = model->rowCount();
+
+    QStringList positions;
+    positions << QString::number(2 * (count / perStripe + 1)) << QString::number(perStripe);
+    for (int i = 0; i < count; i++) {
+        const int row = count - 1 - i;
+        positions << model->index(i, 0).data(FolderModel::UrlRole).toString()
+                  << QString::number(2 * (row / perStripe)) << QString::number(row % perStripe);
+    }
+
+    return positions;
+}
+
+}
+
+#endif // TESTFOLDER_H
@@ -24,6 +24,7 @@
 #include "foldermodel.h"
 #include "itemviewadapter.h"
 #include "positioner.h"
+#include "previewscheduler.h"
 #include "screenmapper.h"
 
 #include <QApplication>
@@ -31,6 +32,9 @@
 #include <QCollator>
 #include <QDesktopWidget>
 #include <QDrag>
+#include <QFileInfo>
+#include <QFontMetrics>
+#include <QFutureWatcher>
 #include <QImage>
 #include <QItemSelectionModel>
 #include <QMenu>
@@ -42,6 +46,8 @@
 #include <QQuickWindow>
 #include <QTimer>
 #include <QLoggingCategory>
+#include <QtConcurrent>
+#include <QtMath>
 #include <qplatformdefs.h>
 
 #include <KDirWatch>
@@ -83,6 +89,7 @@
 #include <unistd.h>
 
 Q_LOGGING_CATEGORY(FOLDERMODEL, "plasma.containments.desktop.folder.foldermodel")
+Q_LOGGING_CATEGORY(FOLDERMODEL_TIMING, "plasma.containments.desktop.folder.timing", QtInfoMsg)
 
 DirLister::DirLister(QObject *parent) : KDirLister(parent)
 {
@@ -107,7 +114,10 @@ FolderModel::FolderModel(QObject *parent) : QSortFilterProxyModel(parent),
     m_dragInProgress(false),
     m_urlChangedWhileDragging(false),
     m_dropTargetPositionsCleanup(new QTimer(this)),
+    m_isDirTimer(new QTimer(this)),
+    m_isDirWatcher(new QFutureWatcher<QVector<DesktopLinkTarget>>(this)),
     m_previewGenerator(nullptr),
+    m_previewScheduler(nullptr),
     m_viewAdapter(nullptr),
     m_actionCollection(this),
     m_newMenu(nullptr),
@@ -121,6 +131,7 @@ FolderModel::FolderModel(QObject *parent) : QSortFilterProxyModel(parent),
     m_previews(false),
     m_filterMode(NoFilter),
     m_filterPatternMatchAll(true),
+    m_filterMimeTypesMatchAll(false),
     m_screenUsed(false),
     m_screenMapper(ScreenMapper::instance()),
     m_complete(false)
@@ -132,11 +143,29 @@ FolderModel::FolderModel(QObject *parent) : QSortFilterProxyModel(parent),
     dirLister->setAutoErrorHandlingEnabled(false, nullptr);
     connect(dirLister, &DirLister::error, this, &FolderModel::dirListFailed);
     connect(dirLister, &KCoreDirLister::itemsDeleted, this, &FolderModel::evictFromIsDirCache);
+    connect(dirLister, &KCoreDirLister::refreshItems, this,
+            [this](const QList<QPair<KFileItem, KFileItem>> &items) {
+        // A modified desktop file may point somewhere else now.
+        for (const auto &item : items) {
+            m_isDirCache.remove(item.second.url());
+            m_mimeTypeCache.remove(item.second.url());
+        }
+    });
 
     connect(dirLister, &KCoreDirLister::started, this, std::bind(&FolderModel::setStatus, this, Status::Listing));
+    connect(dirLister, &KCoreDirLister::started, this, [this] {
+        m_listingTimer.start();
+        m_firstRowTimed = false;
+    });
 
     void (KCoreDirLister::*myCompletedSignal)() = &KCoreDirLister::completed;
     QObject::connect(dirLister, myCompletedSignal, this, [this] {
+        if (m_listingTimer.isValid()) {
+            qCDebug(FOLDERMODEL_TIMING) << "Listing" << m_dirModel->dirLister()->url() << "completed after"
+                << m_listingTimer.elapsed() << "ms with" << rowCount() << "items";
+            m_listingTimer.invalidate();
+        }
+
         setStatus(Status::Ready);
         emit listingCompleted();
     });
@@ -151,6 +180,33 @@ FolderModel::FolderModel(QObject *parent) : QSortFilterProxyModel(parent),
     m_dirModel->setDirLister(dirLister);
     m_dirModel->setDropsAllowed(KDirModel::DropOnDirectory | KDirModel::DropOnLocalExecutable);
 
+    m_previewScheduler = new PreviewScheduler(m_dirModel, this);
+
+    // Keep the sort key and role caches in step with the source model. This
+    // has to be connected before setSourceModel() so the caches are already
+    // up to date when QSortFilterProxyModel reacts to the same signals.
+    connect(m_dirModel, &QAbstractItemModel::rowsInserted,
+            this, [this](const QModelIndex &parent, int first, int last) {
+        if (!parent.isValid()) {
+            insertCachedRows(first, last - first + 1);
+        }
+    });
+    connect(m_dirModel, &QAbstractItemModel::rowsRemoved,
+            this, [this](const QModelIndex &parent, int first, int last) {
+        if (!parent.isValid()) {
+            removeCachedRows(first, last);
+        }
+    });
+    connect(m_dirModel, &QAbstractItemModel::dataChanged,
+            this, [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+        if (!topLeft.parent().isValid()) {
+            invalidateCachedRows(topLeft.row(), bottomRight.row());
+        }
+    });
+    connect(m_dirModel, &QAbstractItemModel::modelReset, this, &FolderModel::clearCachedRows);
+    connect(m_dirModel, &QAbstractItemModel::layoutChanged, this, &FolderModel::clearCachedRows);
+    connect(m_dirModel, &QAbstractItemModel::rowsMoved, this, &FolderModel::clearCachedRows);
+
     // If we have dropped items queued for moving, go unsorted now.
     connect(this, &QAbstractItemModel::rowsAboutToBeInserted,
             this, [this]() {
@@ -159,6 +215,14 @@ FolderModel::FolderModel(QObject *parent) : QSortFilterProxyModel(parent),
             }
     });
 
+    connect(this, &QAbstractItemModel::rowsInserted, this, [this]() {
+        if (m_listingTimer.isValid() && !m_firstRowTimed) {
+            m_firstRowTimed = true;
+            qCDebug(FOLDERMODEL_TIMING) << "First row of" << m_dirModel->dirLister()->url() << "after"
+                << m_listingTimer.elapsed() << "ms";
+        }
+    });
+
     // Position dropped items at the desired target position.
     connect(this, &QAbstractItemModel::rowsInserted,
             this, [this](const QModelIndex &parent, int first, int last) {
@@ -193,6 +257,13 @@ FolderModel::FolderModel(QObject *parent) : QSortFilterProxyModel(parent),
         }
     });
 
+    // Desktop links are resolved in batches off the GUI thread, and all the
+    // resulting changes are applied together once per event loop turn.
+    m_isDirTimer->setInterval(0);
+    m_isDirTimer->setSingleShot(true);
+    connect(m_isDirTimer, &QTimer::timeout, this, &FolderModel::processIsDirQueue);
+    connect(m_isDirWatcher, &QFutureWatcherBase::finished, this, &FolderModel::isDirBatchResolved);
+
     m_selectionModel = new QItemSelectionModel(this, this);
     connect(m_selectionModel, &QItemSelectionModel::selectionChanged,
             this, &FolderModel::selectionChanged);
@@ -267,7 +338,23 @@ void FolderModel::invalidateFilterIfComplete()
         return;
     }
 
+    QElapsedTimer timer;
+    timer.start();
+
     invalidateFilter();
+
+    qCDebug(FOLDERMODEL_TIMING) << "Filtering" << sourceModel()->rowCount() << "items took" << timer.elapsed() << "ms";
+}
+
+void FolderModel::resort()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    invalidateIfComplete();
+    sort(m_sortMode, m_sortDesc ? Qt::DescendingOrder : Qt::AscendingOrder);
+
+    qCDebug(FOLDERMODEL_TIMING) << "Sorting" << rowCount() << "items took" << timer.elapsed() << "ms";
 }
 
 void FolderModel::newFileMenuItemCreated(const QUrl &url)
@@ -299,6 +386,10 @@ void FolderModel::setUrl(const QString& url)
     beginResetModel();
     m_url = url;
     m_isDirCache.clear();
+    m_isDirQueue.clear();
+    m_isDirInFlight.clear();
+    m_isDirChanged.clear();
+    m_mimeTypeCache.clear();
     m_dirModel->dirLister()->openUrl(resolvedNewUrl);
     clearDragImages();
     m_dragIndexes.clear();
@@ -444,8 +535,7 @@ void FolderModel::setSortMode(int mode)
         if (mode == -1 /* Unsorted */) {
             setDynamicSortFilter(false);
         } else {
-            invalidateIfComplete();
-            sort(m_sortMode, m_sortDesc ? Qt::DescendingOrder : Qt::AscendingOrder);
+            resort();
             setDynamicSortFilter(true);
         }
 
@@ -464,8 +554,7 @@ void FolderModel::setSortDesc(bool desc)
         m_sortDesc = desc;
 
         if (m_sortMode != -1 /* Unsorted */) {
-            invalidateIfComplete();
-            sort(m_sortMode, m_sortDesc ? Qt::DescendingOrder : Qt::AscendingOrder);
+            resort();
         }
 
         emit sortDescChanged();
@@ -483,8 +572,7 @@ void FolderModel::setSortDirsFirst(bool enable)
         m_sortDirsFirst = enable;
 
         if (m_sortMode != -1 /* Unsorted */) {
-            invalidateIfComplete();
-            sort(m_sortMode, m_sortDesc ? Qt::DescendingOrder : Qt::AscendingOrder);
+            resort();
         }
 
         emit sortDirsFirstChanged();
@@ -500,6 +588,11 @@ void FolderModel::setParseDesktopFiles(bool enable)
 {
     if (m_parseDesktopFiles != enable) {
         m_parseDesktopFiles = enable;
+
+        for (quint8 &flags : m_roleCache.flags) {
+            flags &= ~RoleCacheHasLinkDestination;
+        }
+
         emit parseDesktopFilesChanged();
     }
 }
@@ -516,12 +609,15 @@ void FolderModel::setViewAdapter(QObject* adapter)
 
         m_viewAdapter = abstractViewAdapter;
 
+        // The generator only resolves the delayed MIME types of visible items;
+        // thumbnails come from the scheduler, which knows what is on screen.
         if (m_viewAdapter && !m_previewGenerator) {
             m_previewGenerator = new KFilePreviewGenerator(abstractViewAdapter, this);
-            m_previewGenerator->setPreviewShown(m_previews);
-            m_previewGenerator->setEnabledPlugins(m_effectivePreviewPlugins);
+            m_previewGenerator->setPreviewShown(false);
         }
 
+        m_previewScheduler->setViewAdapter(qobject_cast<ItemViewAdapter *>(adapter));
+
         emit viewAdapterChanged();
     }
 }
@@ -536,9 +632,7 @@ void FolderModel::setPreviews(bool previews)
     if (m_previews != previews) {
         m_previews = previews;
 
-        if (m_previewGenerator) {
-            m_previewGenerator->setPreviewShown(m_previews);
-        }
+        m_previewScheduler->setEnabled(m_previews);
 
         emit previewsChanged();
     }
@@ -559,11 +653,7 @@ void FolderModel::setPreviewPlugins(const QStringList& previewPlugins)
     if (m_effectivePreviewPlugins != effectivePlugins) {
         m_effectivePreviewPlugins = effectivePlugins;
 
-        if (m_previewGenerator) {
-            m_previewGenerator->setPreviewShown(false);
-            m_previewGenerator->setEnabledPlugins(m_effectivePreviewPlugins);
-            m_previewGenerator->setPreviewShown(true);
-        }
+        m_previewScheduler->setEnabledPlugins(m_effectivePreviewPlugins);
     }
 
     if (m_previewPlugins != previewPlugins) {
@@ -572,6 +662,20 @@ void FolderModel::setPreviewPlugins(const QStringList& previewPlugins)
     }
 }
 
+int FolderModel::maximumPreviewJobs() const
+{
+    return m_previewScheduler->maximumJobs();
+}
+
+void FolderModel::setMaximumPreviewJobs(int jobs)
+{
+    if (m_previewScheduler->maximumJobs() != jobs) {
+        m_previewScheduler->setMaximumJobs(jobs);
+
+        emit maximumPreviewJobsChanged();
+    }
+}
+
 int FolderModel::filterMode() const
 {
     return m_filterMode;
@@ -602,18 +706,37 @@ void FolderModel::setFilterPattern(const QString &pattern)
     m_filterPattern = pattern;
     m_filterPatternMatchAll = (pattern == QLatin1String("*"));
 
-    const QStringList patterns = pattern.split(QLatin1Char(' '));
-    m_regExps.clear();
-    m_regExps.reserve(patterns.count());
+    const QStringList patterns = pattern.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    QStringList regExps;
+
+    m_filterSuffixes.clear();
 
-    foreach (const QString &pattern, patterns) {
-        QRegExp rx(pattern);
-        rx.setPatternSyntax(QRegExp::Wildcard);
-        rx.setCaseSensitivity(Qt::CaseInsensitive);
-        m_regExps.append(rx);
+    for (const QString &glob : patterns) {
+        const QString suffix = glob.mid(1).toLower();
+        const int dot = suffix.lastIndexOf(QLatin1Char('.'));
+
+        if (glob.startsWith(QLatin1Char('*')) && dot != -1
+            && std::none_of(suffix.cbegin(), suffix.cend(), [](QChar c) {
+                   return c == QLatin1Char('*') || c == QLatin1Char('?')
+                       || c == QLatin1Char('[') || c == QLatin1Char('\\');
+               })) {
+            m_filterSuffixes[suffix.mid(dot + 1)].append(suffix);
+        } else {
+            regExps.append(QRegularExpression::wildcardToRegularExpression(glob));
+        }
     }
 
-    invalidateFilterIfComplete();
+    if (regExps.isEmpty()) {
+        m_filterRegExp = QRegularExpression();
+    } else {
+        m_filterRegExp = QRegularExpression(regExps.join(QLatin1Char('|')),
+                                            QRegularExpression::CaseInsensitiveOption);
+        m_filterRegExp.optimize();
+    }
+
+    if (m_filterMode != NoFilter) {
+        invalidateFilterIfComplete();
+    }
 
     emit filterPatternChanged();
 }
@@ -628,10 +751,16 @@ void FolderModel::setFilterMimeTypes(const QStringList &mimeList)
     const QSet<QString> set(mimeList.constBegin(), mimeList.constEnd());
 
     if (m_mimeSet != set) {
+        const bool matchedAll = m_filterMimeTypesMatchAll;
 
         m_mimeSet = set;
+        m_filterMimeTypesMatchAll = m_mimeSet.contains(QLatin1String("all/all"))
+            || m_mimeSet.contains(QLatin1String("all/allfiles"));
 
-        invalidateFilterIfComplete();
+        // Nothing to re-evaluate if every type matched before and still does.
+        if (m_filterMode != NoFilter && !(matchedAll && m_filterMimeTypesMatchAll)) {
+            invalidateFilterIfComplete();
+        }
 
         emit filterMimeTypesChanged();
     }
@@ -840,19 +969,44 @@ void FolderModel::setRangeSelected(int anchor, int to)
 
 void FolderModel::updateSelection(const QVariantList &rows, bool toggle)
 {
-    QItemSelection newSelection;
-
-    int iRow = -1;
+    const int rowCount = this->rowCount();
+    QVector<int> sortedRows;
+    sortedRows.reserve(rows.count());
 
     foreach (const QVariant &row, rows) {
-        iRow = row.toInt();
+        const int iRow = row.toInt();
 
         if (iRow < 0) {
             return;
         }
 
-        const QModelIndex &idx = index(iRow, 0);
-        newSelection.select(idx, idx);
+        if (iRow < rowCount) {
+            sortedRows.append(iRow);
+        }
+    }
+
+    std::sort(sortedRows.begin(), sortedRows.end());
+    sortedRows.erase(std::unique(sortedRows.begin(), sortedRows.end()), sortedRows.end());
+
+    // A rubber band reports the same rows again for most mouse moves.
+    if (sortedRows == m_rubberBandRows && toggle == m_rubberBandToggle
+        && m_pinnedSelection == m_rubberBandPinnedSelection
+        && m_selectionModel->selection() == m_rubberBandSelection) {
+        return;
+    }
+
+    // Coalesce consecutive rows into a single range each.
+    QItemSelection newSelection;
+
+    for (int i = 0; i < sortedRows.count(); ) {
+        int last = i;
+
+        while (last + 1 < sortedRows.count() && sortedRows.at(last + 1) == sortedRows.at(last) + 1) {
+            ++last;
+        }
+
+        newSelection.append(QItemSelectionRange(index(sortedRows.at(i), 0), index(sortedRows.at(last), 0)));
+        i = last + 1;
     }
 
     if (toggle) {
@@ -862,6 +1016,11 @@ void FolderModel::updateSelection(const QVariantList &rows, bool toggle)
     } else {
         m_selectionModel->select(newSelection, QItemSelectionModel::ClearAndSelect);
     }
+
+    m_rubberBandRows = sortedRows;
+    m_rubberBandToggle = toggle;
+    m_rubberBandPinnedSelection = m_pinnedSelection;
+    m_rubberBandSelection = m_selectionModel->selection();
 }
 
 void FolderModel::clearSelection()
@@ -920,48 +1079,84 @@ QPoint FolderModel::dragCursorOffset(int row)
     return image->cursorOffset;
 }
 
-void FolderModel::addDragImage(QDrag *drag, int x, int y)
+void FolderModel::addDragImage(QDrag *drag, int x, int y, int count)
 {
     if (!drag || m_dragImages.isEmpty()) {
         return;
     }
 
-    QRegion region;
+    // Only the first few items are drawn into the drag pixmap, so dragging a
+    // large selection doesn't allocate a huge image; a badge shows the count.
+    static const int maxPaintedImages = 16;
+    static const int maxPixmapExtent = 512;
 
-    foreach (DragImage *image, m_dragImages) {
+    const QPoint cursor(x, y);
+    QVector<DragImage *> painted;
+    QRect rect;
+
+    for (DragImage *image : qAsConst(m_dragImages)) {
         image->blank = isBlank(image->row);
-        image->rect.translate(-m_dragHotSpotScrollOffset.x(), -m_dragHotSpotScrollOffset.y());
-        if (!image->blank && !image->image.isNull()) {
-            region = region.united(image->rect);
+
+        if (image->blank || image->image.isNull()) {
+            continue;
         }
+
+        const QRect imageRect = image->rect.translated(-m_dragHotSpotScrollOffset);
+        image->cursorOffset = imageRect.topLeft() - cursor;
+
+        if (painted.count() < maxPaintedImages) {
+            painted.append(image);
+            rect |= imageRect;
+        }
+    }
+
+    if (painted.isEmpty()) {
+        return;
     }
 
-    QRect rect = region.boundingRect();
-    QPoint offset = rect.topLeft();
-    rect.translate(-offset.x(), -offset.y());
+    const qreal scale = qMin<qreal>(1.0, qreal(maxPixmapExtent) / qMax(rect.width(), rect.height()));
+    const QSize size(qCeil(rect.width() * scale), qCeil(rect.height() * scale));
 
-    QImage dragImage(rect.size(), QImage::Format_RGBA8888);
-    dragImage.fill(Qt::transparent);
+    if (m_dragPixmap.size() != size) {
+        m_dragPixmap = QPixmap(size);
+    }
 
-    QPainter painter(&dragImage);
+    m_dragPixmap.fill(Qt::transparent);
 
-    QPoint pos;
+    QPainter painter(&m_dragPixmap);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.scale(scale, scale);
 
-    foreach (DragImage *image, m_dragImages) {
-        if (!image->blank && !image->image.isNull()) {
-            pos = image->rect.translated(-offset.x(), -offset.y()).topLeft();
-            image->cursorOffset.setX(pos.x() - (x - offset.x()));
-            image->cursorOffset.setY(pos.y() - (y - offset.y()));
+    for (const DragImage *image : qAsConst(painted)) {
+        painter.drawImage(image->rect.translated(-m_dragHotSpotScrollOffset).topLeft() - rect.topLeft(), image->image);
+    }
 
-            painter.drawImage(pos, image->image);
-        }
+    painter.resetTransform();
 
-        // FIXME HACK: Operate on copy.
-        image->rect.translate(m_dragHotSpotScrollOffset.x(), m_dragHotSpotScrollOffset.y());
+    if (count > painted.count()) {
+        QFont font = QApplication::font();
+        font.setBold(true);
+        painter.setFont(font);
+
+        const QString text = QString::number(count);
+        const QFontMetrics metrics(font);
+        const int height = metrics.height() + 4;
+        const int width = qMax(height, metrics.horizontalAdvance(text) + height / 2);
+        const QRect badge(size.width() - width, 0, width, height);
+        const QPalette palette = QApplication::palette();
+
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(palette.color(QPalette::Highlight));
+        painter.drawRoundedRect(badge, height / 2.0, height / 2.0);
+        painter.setPen(palette.color(QPalette::HighlightedText));
+        painter.drawText(badge, Qt::AlignCenter, text);
     }
 
-    drag->setPixmap(QPixmap::fromImage(dragImage));
-    drag->setHotSpot(QPoint(x - offset.x(), y - offset.y()));
+    painter.end();
+
+    drag->setPixmap(m_dragPixmap);
+    drag->setHotSpot((cursor - rect.topLeft()) * scale);
 }
 
 void FolderModel::dragSelected(int x, int y)
@@ -995,9 +1190,12 @@ void FolderModel::dragSelectedInternal(int x, int y)
 
     QDrag *drag = new QDrag(item);
 
-    addDragImage(drag, x, y);
+    // Built once per drag, the items are only blanked after painting them.
+    const QModelIndexList selection = m_selectionModel->selectedIndexes();
 
-    m_dragIndexes = m_selectionModel->selectedIndexes();
+    addDragImage(drag, x, y, selection.count());
+
+    m_dragIndexes = selection;
 
     std::sort(m_dragIndexes.begin(), m_dragIndexes.end());
 
@@ -1312,32 +1510,37 @@ QVariant FolderModel::data(const QModelIndex& index, int role) const
     if (role == BlankRole) {
         return m_dragIndexes.contains(index);
     } else if (role == OverlaysRole) {
-        const KFileItem item = itemForIndex(index);
-        return item.overlays();
+        return m_roleCache.overlays.at(cachedRow(index));
     } else if (role == SelectedRole) {
         return m_selectionModel->isSelected(index);
     } else if (role == IsDirRole) {
         return isDir(mapToSource(index), m_dirModel);
     } else if (role == IsLinkRole) {
-        const KFileItem item = itemForIndex(index);
-        return item.isLink();
+        return bool(m_roleCache.flags.at(cachedRow(index)) & RoleCacheIsLink);
     } else if (role == IsHiddenRole) {
-        const KFileItem item = itemForIndex(index);
-        return item.isHidden();
+        return bool(m_roleCache.flags.at(cachedRow(index)) & RoleCacheIsHidden);
     } else if (role == UrlRole) {
-        return itemForIndex(index).url();
+        return m_roleCache.urls.at(cachedRow(index));
     } else if (role == LinkDestinationUrl) {
-        const KFileItem item = itemForIndex(index);
+        const int row = cachedRow(index);
 
-        if (m_parseDesktopFiles && item.isDesktopFile()) {
-            const KDesktopFile file(item.targetUrl().path());
+        if (!(m_roleCache.flags.at(row) & RoleCacheHasLinkDestination)) {
+            const KFileItem item = itemForIndex(index);
+            QVariant destination = item.targetUrl();
 
-            if (file.hasLinkType()) {
-                return file.readUrl();
+            if (m_parseDesktopFiles && item.isDesktopFile()) {
+                const KDesktopFile file(item.targetUrl().path());
+
+                if (file.hasLinkType()) {
+                    destination = file.readUrl();
+                }
             }
+
+            m_roleCache.linkDestinations[row] = destination;
+            m_roleCache.flags[row] |= RoleCacheHasLinkDestination;
         }
 
-        return item.targetUrl();
+        return m_roleCache.linkDestinations.at(row);
     } else if (role == SizeRole) {
         bool isDir = data(index, IsDirRole).toBool();
 
@@ -1347,7 +1550,7 @@ QVariant FolderModel::data(const QModelIndex& index, int role) const
     } else if (role == TypeRole) {
         return m_dirModel->data(mapToSource(QSortFilterProxyModel::index(index.row(), 6)), Qt::DisplayRole);
     } else if (role == FileNameRole) {
-        return itemForIndex(index).url().fileName();
+        return m_roleCache.fileNames.at(cachedRow(index));
     }
 
     return QSortFilterProxyModel::data(index, role);
@@ -1376,40 +1579,106 @@ bool FolderModel::isDir(const QModelIndex &index, const KDirModel *dirModel) con
     }
 
     if (m_parseDesktopFiles && item.isDesktopFile()) {
-        // Check if the desktop file is a link to a directory
-        KDesktopFile file(item.targetUrl().path());
+        // Parsing the desktop file and checking its link target is done by a
+        // background resolver; report a file until the result is in.
+        const QUrl url = item.url();
 
-        if (!file.hasLinkType()) {
-            return false;
+        if (!m_isDirInFlight.contains(url) && !m_isDirJobs.contains(url)) {
+            m_isDirQueue.insert(url, item.targetUrl().path());
+
+            if (!m_isDirTimer->isActive()) {
+                m_isDirTimer->start();
+            }
         }
+    }
 
-        const QUrl url(file.readUrl());
+    return false;
+}
 
-        // Check if we already have a running StatJob for this URL.
-        if (m_isDirJobs.contains(item.url())) {
-            return false;
+QVector<FolderModel::DesktopLinkTarget> FolderModel::resolveDesktopLinks(const QHash<QUrl, QString> &links)
+{
+    QVector<DesktopLinkTarget> results;
+    results.reserve(links.count());
+
+    for (auto it = links.constBegin(); it != links.constEnd(); ++it) {
+        DesktopLinkTarget result{it.key(), QUrl(), DesktopLinkTarget::NotADirectory};
+
+        const KDesktopFile file(it.value());
+
+        if (file.hasLinkType()) {
+            result.target = QUrl(file.readUrl());
+
+            // Assume the root folder of a protocol is always a folder.
+            // This avoids spinning up e.g. trash KIO slave just to check whether trash:/ is a folder.
+            if (result.target.path() == QLatin1String("/")) {
+                result.state = DesktopLinkTarget::Directory;
+            } else if (result.target.isLocalFile()) {
+                result.state = QFileInfo(result.target.toLocalFile()).isDir()
+                    ? DesktopLinkTarget::Directory : DesktopLinkTarget::NotADirectory;
+            } else {
+                result.state = DesktopLinkTarget::NeedsStat;
+            }
+        }
+
+        results.append(result);
+    }
+
+    return results;
+}
+
+void FolderModel::processIsDirQueue()
+{
+    applyIsDirChanges();
+
+    if (m_isDirQueue.isEmpty() || m_isDirWatcher->isRunning()) {
+        return;
+    }
+
+    QHash<QUrl, QString> batch;
+    batch.swap(m_isDirQueue);
+
+    for (auto it = batch.constBegin(); it != batch.constEnd(); ++it) {
+        m_isDirInFlight.insert(it.key());
+    }
+
+    m_isDirWatcher->setFuture(QtConcurrent::run(&FolderModel::resolveDesktopLinks, batch));
+}
+
+void FolderModel::isDirBatchResolved()
+{
+    const QVector<DesktopLinkTarget> results = m_isDirWatcher->result();
+
+    for (const DesktopLinkTarget &result : results) {
+        // The folder was changed while the batch was in flight.
+        if (!m_isDirInFlight.remove(result.url)) {
+            continue;
         }
 
-        // Assume the root folder of a protocol is always a folder.
-        // This avoids spinning up e.g. trash KIO slave just to check whether trash:/ is a folder.
-        if (url.path() == QLatin1String("/")) {
-            m_isDirCache.insert(item.url(), true);
-            return true;
+        if (result.state != DesktopLinkTarget::NeedsStat) {
+            const bool isDir = (result.state == DesktopLinkTarget::Directory);
+            m_isDirCache.insert(result.url, isDir);
+
+            if (isDir) {
+                m_isDirChanged.insert(result.url);
+            }
+
+            continue;
         }
 
-        if (KProtocolInfo::protocolClass(url.scheme()) != QLatin1String(":local")) {
-            return false;
+        if (KProtocolInfo::protocolClass(result.target.scheme()) != QLatin1String(":local")) {
+            m_isDirCache.insert(result.url, false);
+            continue;
         }
 
-        KIO::StatJob *job = KIO::stat(url, KIO::HideProgressInfo);
-        job->setProperty("org.kde.plasma.folder_url", item.url());
+        KIO::StatJob *job = KIO::stat(result.target, KIO::HideProgressInfo);
+        job->setProperty("org.kde.plasma.folder_url", result.url);
         job->setSide(KIO::StatJob::SourceSide);
         job->setDetails(0);
         connect(job, &KJob::result, this, &FolderModel::statResult);
-        m_isDirJobs.insert(item.url(), job);
+        m_isDirJobs.insert(result.url, job);
     }
 
-    return false;
+    processIsDirQueue();
 }
 
 void FolderModel::statResult(KJob *job)
@@ -1417,15 +1686,61 @@ void FolderModel::statResult(KJob *job)
     KIO::StatJob *statJob = static_cast<KIO::StatJob*>(job);
 
     const QUrl &url = statJob->property("org.kde.plasma.folder_url").toUrl();
-    const QModelIndex &idx = index(indexForUrl(url), 0);
 
-    if (idx.isValid() && statJob->error() == KJob::NoError) {
-        m_isDirCache[url] = statJob->statResult().isDir();
+    if (m_isDirJobs.remove(url) && statJob->error() == KJob::NoError) {
+        const bool isDir = statJob->statResult().isDir();
+        m_isDirCache[url] = isDir;
+
+        if (isDir) {
+            m_isDirChanged.insert(url);
+
+            if (!m_isDirTimer->isActive()) {
+                m_isDirTimer->start();
+            }
+        }
+    }
+}
 
-        emit dataChanged(idx, idx, QVector<int>() << IsDirRole);
+void FolderModel::applyIsDirChanges()
+{
+    if (m_isDirChanged.isEmpty()) {
+        return;
     }
 
-    m_isDirJobs.remove(url);
+    QSet<QUrl> changed;
+    changed.swap(m_isDirChanged);
+
+    // Unresolved links are reported as files, so only a change to "is a
+    // directory" can move rows around.
+    for (const QUrl &url : qAsConst(changed)) {
+        const QModelIndex sourceIndex = m_dirModel->indexForUrl(url);
+
+        if (sourceIndex.isValid()) {
+            invalidateSortKeys(sourceIndex.row(), sourceIndex.row());
+        }
+    }
+
+    if (m_sortMode != -1 /* Unsorted */ && (m_sortDirsFirst || m_sortMode == KDirModel::Size)) {
+        invalidateIfComplete();
+    }
+
+    int first = -1;
+    int last = -1;
+
+    for (const QUrl &url : qAsConst(changed)) {
+        const int row = indexForUrl(url);
+
+        if (row < 0) {
+            continue;
+        }
+
+        first = (first == -1) ? row : qMin(first, row);
+        last = qMax(last, row);
+    }
+
+    if (first != -1) {
+        emit dataChanged(index(first, 0), index(last, 0), QVector<int>() << IsDirRole);
+    }
 }
 
 void FolderModel::evictFromIsDirCache(const KFileItemList& items)
@@ -1433,34 +1748,161 @@ void FolderModel::evictFromIsDirCache(const KFileItemList& items)
     foreach (const KFileItem &item, items) {
         m_screenMapper->removeFromMap(item.url());
         m_isDirCache.remove(item.url());
+        m_mimeTypeCache.remove(item.url());
+    }
+}
+
+const FolderModel::SortKey *FolderModel::sortKey(const QModelIndex &sourceIndex) const
+{
+    // lessThan() sizes the cache, growing it here would move keys already handed out.
+    Q_ASSERT(sourceIndex.row() < m_sortKeys.count());
+    std::optional<SortKey> &key = m_sortKeys[sourceIndex.row()];
+
+    if (!key) {
+        const KFileItem item = m_dirModel->itemForIndex(sourceIndex);
+
+        key = SortKey {
+            m_collator.sortKey(item.text()),
+            m_collator.sortKey(item.name()),
+            item.url().url(),
+            item.size(),
+            item.entry().numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME, -1),
+            isDir(sourceIndex, m_dirModel)
+        };
+    }
+
+    return &*key;
+}
+
+void FolderModel::invalidateSortKeys(int first, int last)
+{
+    last = qMin(last, m_sortKeys.count() - 1);
+
+    for (int i = first; i <= last; ++i) {
+        m_sortKeys[i].reset();
+    }
+}
+
+int FolderModel::cachedRow(const QModelIndex &index) const
+{
+    const QModelIndex sourceIndex = mapToSource(index);
+    const int row = sourceIndex.row();
+
+    if (row >= m_roleCache.flags.count()) {
+        resizeRoleCache(qMax(row + 1, m_dirModel->rowCount(sourceIndex.parent())));
+    }
+
+    if (!(m_roleCache.flags.at(row) & RoleCacheFilled)) {
+        const KFileItem item = m_dirModel->itemForIndex(sourceIndex);
+
+        quint8 flags = RoleCacheFilled;
+
+        if (item.isLink()) {
+            flags |= RoleCacheIsLink;
+        }
+
+        if (item.isHidden()) {
+            flags |= RoleCacheIsHidden;
+        }
+
+        m_roleCache.flags[row] = flags;
+        m_roleCache.urls[row] = item.url();
+        m_roleCache.fileNames[row] = item.url().fileName();
+        m_roleCache.overlays[row] = item.overlays();
+        m_roleCache.linkDestinations[row] = QVariant();
+    }
+
+    return row;
+}
+
+void FolderModel::resizeRoleCache(int size) const
+{
+    m_roleCache.flags.resize(size);
+    m_roleCache.urls.resize(size);
+    m_roleCache.fileNames.resize(size);
+    m_roleCache.overlays.resize(size);
+    m_roleCache.linkDestinations.resize(size);
+}
+
+void FolderModel::insertCachedRows(int first, int count)
+{
+    if (first <= m_sortKeys.count()) {
+        m_sortKeys.insert(first, count, std::nullopt);
+    }
+
+    if (first <= m_roleCache.flags.count()) {
+        m_roleCache.flags.insert(first, count, 0);
+        m_roleCache.urls.insert(first, count, QUrl());
+        m_roleCache.fileNames.insert(first, count, QString());
+        m_roleCache.overlays.insert(first, count, QStringList());
+        m_roleCache.linkDestinations.insert(first, count, QVariant());
     }
 }
 
+void FolderModel::removeCachedRows(int first, int last)
+{
+    if (first < m_sortKeys.count()) {
+        const int sortKeysLast = qMin(last, m_sortKeys.count() - 1);
+        m_sortKeys.remove(first, sortKeysLast - first + 1);
+    }
+
+    if (first < m_roleCache.flags.count()) {
+        const int count = qMin(last, m_roleCache.flags.count() - 1) - first + 1;
+        m_roleCache.flags.remove(first, count);
+        m_roleCache.urls.remove(first, count);
+        m_roleCache.fileNames.remove(first, count);
+        m_roleCache.overlays.remove(first, count);
+        m_roleCache.linkDestinations.remove(first, count);
+    }
+}
+
+void FolderModel::invalidateCachedRows(int first, int last)
+{
+    invalidateSortKeys(first, last);
+
+    last = qMin(last, m_roleCache.flags.count() - 1);
+
+    for (int i = first; i <= last; ++i) {
+        m_roleCache.flags[i] = 0;
+    }
+}
+
+void FolderModel::clearCachedRows()
+{
+    m_sortKeys.clear();
+
+    resizeRoleCache(0);
+}
+
 bool FolderModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
 {
     const KDirModel *dirModel = static_cast<KDirModel*>(sourceModel());
 
-    if (m_sortDirsFirst || left.column() == KDirModel::Size) {
-        bool leftIsDir = isDir(left, dirModel);
-        bool rightIsDir = isDir(right, dirModel);
+    const int maxRow = qMax(left.row(), right.row());
+    if (maxRow >= m_sortKeys.count()) {
+        m_sortKeys.resize(qMax(maxRow + 1, m_dirModel->rowCount(left.parent())));
+    }
 
-        if (leftIsDir && !rightIsDir) {
+    const SortKey *leftKey = sortKey(left);
+    const SortKey *rightKey = sortKey(right);
+
+    if (m_sortDirsFirst || left.column() == KDirModel::Size) {
+        if (leftKey->isDir && !rightKey->isDir) {
             return (sortOrder() == Qt::AscendingOrder);
         }
 
-        if (!leftIsDir && rightIsDir) {
+        if (!leftKey->isDir && rightKey->isDir) {
             return (sortOrder() == Qt::DescendingOrder);
         }
     }
 
-    const KFileItem leftItem = dirModel->data(left, KDirModel::FileItemRole).value<KFileItem>();
-    const KFileItem rightItem = dirModel->data(right, KDirModel::FileItemRole).value<KFileItem>();
     const int column = left.column();
     int result = 0;
 
     switch (column) {
         case KDirModel::Size: {
-                if (isDir(left, dirModel) && isDir(right, dirModel)) {
+                if (leftKey->isDir && rightKey->isDir) {
+                    // KDirModel caches the child count per node, no need to duplicate it.
                     const int leftChildCount = dirModel->data(left, KDirModel::ChildCountRole).toInt();
                     const int rightChildCount = dirModel->data(right, KDirModel::ChildCountRole).toInt();
                     if (leftChildCount < rightChildCount)
@@ -1468,22 +1910,18 @@ bool FolderModel::lessThan(const QModelIndex &left, const QModelIndex &right) co
                     else if (leftChildCount > rightChildCount)
                         result = +1;
                 } else {
-                    const KIO::filesize_t leftSize = leftItem.size();
-                    const KIO::filesize_t rightSize = rightItem.size();
-                    if (leftSize < rightSize)
+                    if (leftKey->size < rightKey->size)
                         result = -1;
-                    else if (leftSize > rightSize)
+                    else if (leftKey->size > rightKey->size)
                         result = +1;
                 }
 
                 break;
             }
         case KDirModel::ModifiedTime: {
-                const long long leftTime = leftItem.entry().numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME, -1);
-                const long long rightTime = rightItem.entry().numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME, -1);
-                if (leftTime < rightTime)
+                if (leftKey->modificationTime < rightKey->modificationTime)
                     result = -1;
-                else if (leftTime > rightTime)
+                else if (leftKey->modificationTime > rightKey->modificationTime)
                     result = +1;
 
                 break;
@@ -1500,19 +1938,17 @@ bool FolderModel::lessThan(const QModelIndex &left, const QModelIndex &right) co
     if (result != 0)
         return result < 0;
 
-    QCollator collator;
-
-    result = collator.compare(leftItem.text(), rightItem.text());
+    result = leftKey->text.compare(rightKey->text);
 
     if (result != 0)
         return result < 0;
 
-    result = collator.compare(leftItem.name(), rightItem.name());
+    result = leftKey->name.compare(rightKey->name);
 
     if (result != 0)
         return result < 0;
 
-    return QString::compare(leftItem.url().url(), rightItem.url().url(), Qt::CaseSensitive);
+    return QString::compare(leftKey->url, rightKey->url, Qt::CaseSensitive) < 0;
 }
 
 Qt::DropActions FolderModel::supportedDragActions() const
@@ -1531,12 +1967,22 @@ inline bool FolderModel::matchMimeType(const KFileItem &item) const
         return false;
     }
 
-    if (m_mimeSet.contains(QLatin1String("all/all")) || m_mimeSet.contains(QLatin1String("all/allfiles"))) {
+    if (m_filterMimeTypesMatchAll) {
         return true;
     }
 
-    const QString mimeType = item.determineMimeType().name();
-    return m_mimeSet.contains(mimeType);
+    return m_mimeSet.contains(mimeTypeName(item));
+}
+
+QString FolderModel::mimeTypeName(const KFileItem &item) const
+{
+    auto it = m_mimeTypeCache.constFind(item.url());
+
+    if (it == m_mimeTypeCache.constEnd()) {
+        it = m_mimeTypeCache.insert(item.url(), item.determineMimeType().name());
+    }
+
+    return *it;
 }
 
 inline bool FolderModel::matchPattern(const KFileItem &item) const
@@ -1546,14 +1992,24 @@ inline bool FolderModel::matchPattern(const KFileItem &item) const
     }
 
     const QString name = item.name();
-    QListIterator<QRegExp> i(m_regExps);
-    while (i.hasNext()) {
-        if (i.next().exactMatch(name)) {
-            return true;
+
+    if (!m_filterSuffixes.isEmpty()) {
+        const int dot = name.lastIndexOf(QLatin1Char('.'));
+
+        if (dot != -1) {
+            const auto it = m_filterSuffixes.constFind(name.mid(dot + 1).toLower());
+
+            if (it != m_filterSuffixes.constEnd()) {
+                for (const QString &suffix : *it) {
+                    if (name.endsWith(suffix, Qt::CaseInsensitive)) {
+                        return true;
+                    }
+                }
+            }
         }
     }
 
-    return false;
+    return !m_filterRegExp.pattern().isEmpty() && m_filterRegExp.match(name).hasMatch();
 }
 
 bool FolderModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
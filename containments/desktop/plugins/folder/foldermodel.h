@@ -22,14 +22,18 @@
 #ifndef FOLDERMODEL_H
 #define FOLDERMODEL_H
 
+#include <QCollator>
+#include <QElapsedTimer>
 #include <QImage>
 #include <QItemSelection>
+#include <QLoggingCategory>
+#include <QPixmap>
 #include <QQmlParserStatus>
 #include <QPointer>
 #include <QSortFilterProxyModel>
 #include <QStringList>
 #include <QSet>
-#include <QRegExp>
+#include <QRegularExpression>
 
 #include <KAbstractViewAdapter>
 #include <KActionCollection>
@@ -38,10 +42,17 @@
 
 #include <KNewFileMenu>
 
+#include <optional>
+
 #include "folderplugin_private_export.h"
 
+// Durations of listing, sorting, filtering and position restore, for
+// spotting performance regressions in the field.
+Q_DECLARE_LOGGING_CATEGORY(FOLDERMODEL_TIMING)
+
 class QDrag;
 class QItemSelectionModel;
+template<typename T> class QFutureWatcher;
 class QQuickItem;
 
 class KFileCopyToMenu;
@@ -58,6 +69,7 @@ namespace KIO {
     class StatJob;
 }
 
+class PreviewScheduler;
 class ScreenMapper;
 
 class DirLister : public KDirLister
@@ -95,6 +107,7 @@ class FOLDERPLUGIN_TESTS_EXPORT FolderModel : public QSortFilterProxyModel, publ
     Q_PROPERTY(QObject* viewAdapter READ viewAdapter WRITE setViewAdapter NOTIFY viewAdapterChanged)
     Q_PROPERTY(bool previews READ previews WRITE setPreviews NOTIFY previewsChanged)
     Q_PROPERTY(QStringList previewPlugins READ previewPlugins WRITE setPreviewPlugins NOTIFY previewPluginsChanged)
+    Q_PROPERTY(int maximumPreviewJobs READ maximumPreviewJobs WRITE setMaximumPreviewJobs NOTIFY maximumPreviewJobsChanged)
     Q_PROPERTY(int filterMode READ filterMode WRITE setFilterMode NOTIFY filterModeChanged)
     Q_PROPERTY(QString filterPattern READ filterPattern WRITE setFilterPattern NOTIFY filterPatternChanged)
     Q_PROPERTY(QStringList filterMimeTypes READ filterMimeTypes WRITE setFilterMimeTypes NOTIFY filterMimeTypesChanged)
@@ -180,6 +193,9 @@ class FOLDERPLUGIN_TESTS_EXPORT FolderModel : public QSortFilterProxyModel, publ
         QStringList previewPlugins() const;
         void setPreviewPlugins(const QStringList &previewPlugins);
 
+        int maximumPreviewJobs() const;
+        void setMaximumPreviewJobs(int jobs);
+
         int filterMode() const;
         void setFilterMode(int filterMode);
 
@@ -272,6 +288,7 @@ class FOLDERPLUGIN_TESTS_EXPORT FolderModel : public QSortFilterProxyModel, publ
         void viewAdapterChanged();
         void previewsChanged() const;
         void previewPluginsChanged() const;
+        void maximumPreviewJobsChanged() const;
         void filterModeChanged() const;
         void filterPatternChanged() const;
         void filterMimeTypesChanged() const;
@@ -285,11 +302,14 @@ class FOLDERPLUGIN_TESTS_EXPORT FolderModel : public QSortFilterProxyModel, publ
         bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
         bool matchMimeType(const KFileItem &item) const;
         bool matchPattern(const KFileItem &item) const;
+        QString mimeTypeName(const KFileItem &item) const;
 
     private Q_SLOTS:
         void dragSelectedInternal(int x, int y);
         void dirListFailed(const QString &error);
         void statResult(KJob *job);
+        void processIsDirQueue();
+        void isDirBatchResolved();
         void evictFromIsDirCache(const KFileItemList &items);
         void selectionChanged(const QItemSelection &selected, const QItemSelection &deselected);
         void pasteTo();
@@ -310,10 +330,59 @@ class FOLDERPLUGIN_TESTS_EXPORT FolderModel : public QSortFilterProxyModel, publ
             bool blank;
         };
 
+        struct DesktopLinkTarget {
+            enum State {
+                NotADirectory,
+                Directory,
+                NeedsStat
+            };
+
+            QUrl url;
+            QUrl target;
+            State state;
+        };
+
+        enum RoleCacheFlag {
+            RoleCacheFilled = 0x1,
+            RoleCacheIsLink = 0x2,
+            RoleCacheIsHidden = 0x4,
+            RoleCacheHasLinkDestination = 0x8
+        };
+
+        // Role data read by the delegates, as a struct of arrays indexed by
+        // source row. Filled on first read of a row.
+        struct RoleCache {
+            QVector<quint8> flags;
+            QVector<QUrl> urls;
+            QVector<QString> fileNames;
+            QVector<QStringList> overlays;
+            QVector<QVariant> linkDestinations;
+        };
+
+        struct SortKey {
+            QCollatorSortKey text;
+            QCollatorSortKey name;
+            QString url;
+            KIO::filesize_t size;
+            long long modificationTime;
+            bool isDir;
+        };
+
         void createActions();
         void updatePasteAction();
-        void addDragImage(QDrag *drag, int x, int y);
+        void addDragImage(QDrag *drag, int x, int y, int count);
         void setStatus(Status status);
+        static QVector<DesktopLinkTarget> resolveDesktopLinks(const QHash<QUrl, QString> &links);
+        void applyIsDirChanges();
+        void resort();
+        const SortKey *sortKey(const QModelIndex &sourceIndex) const;
+        void invalidateSortKeys(int first, int last);
+        int cachedRow(const QModelIndex &index) const;
+        void resizeRoleCache(int size) const;
+        void insertCachedRows(int first, int count);
+        void removeCachedRows(int first, int last);
+        void invalidateCachedRows(int first, int last);
+        void clearCachedRows();
         static bool isTrashEmpty();
         QList<QUrl> selectedUrls() const;
         KDirModel *m_dirModel;
@@ -321,10 +390,28 @@ class FOLDERPLUGIN_TESTS_EXPORT FolderModel : public QSortFilterProxyModel, publ
         QString m_url;
         mutable QHash<QUrl, bool> m_isDirCache;
         mutable QHash<QUrl, KIO::StatJob *> m_isDirJobs;
+        // Desktop files whose link target still needs to be resolved, mapped to their local path.
+        mutable QHash<QUrl, QString> m_isDirQueue;
+        QSet<QUrl> m_isDirInFlight;
+        QSet<QUrl> m_isDirChanged;
+        QElapsedTimer m_listingTimer;
+        bool m_firstRowTimed = false;
+        QTimer *m_isDirTimer;
+        QFutureWatcher<QVector<DesktopLinkTarget>> *m_isDirWatcher;
+        QCollator m_collator;
+        // Sort keys indexed by source row, built lazily on first comparison.
+        mutable QVector<std::optional<SortKey>> m_sortKeys;
+        mutable RoleCache m_roleCache;
         QItemSelectionModel *m_selectionModel;
         QItemSelection m_pinnedSelection;
+        // Last rubber band state passed to updateSelection().
+        QVector<int> m_rubberBandRows;
+        bool m_rubberBandToggle = false;
+        QItemSelection m_rubberBandPinnedSelection;
+        QItemSelection m_rubberBandSelection;
         QModelIndexList m_dragIndexes;
-        QHash<int, DragImage *> m_dragImages;
+        QMap<int, DragImage *> m_dragImages;
+        QPixmap m_dragPixmap;
         QPoint m_dragHotSpotScrollOffset;
         bool m_dragInProgress;
         bool m_urlChangedWhileDragging;
@@ -333,6 +420,7 @@ class FOLDERPLUGIN_TESTS_EXPORT FolderModel : public QSortFilterProxyModel, publ
         QHash<QString, QPoint> m_dropTargetPositions;
         QTimer *m_dropTargetPositionsCleanup;
         QPointer<KFilePreviewGenerator> m_previewGenerator;
+        PreviewScheduler *m_previewScheduler;
         QPointer<KAbstractViewAdapter> m_viewAdapter;
         KActionCollection m_actionCollection;
         KNewFileMenu *m_newMenu;
@@ -356,7 +444,12 @@ class FOLDERPLUGIN_TESTS_EXPORT FolderModel : public QSortFilterProxyModel, publ
         QString m_filterPattern;
         bool m_filterPatternMatchAll;
         QSet<QString> m_mimeSet;
-        QList<QRegExp> m_regExps;
+        bool m_filterMimeTypesMatchAll;
+        // Pure suffix globs like "*.txt" by their lower-cased last extension,
+        // and all other globs compiled into a single alternation.
+        QHash<QString, QStringList> m_filterSuffixes;
+        QRegularExpression m_filterRegExp;
+        mutable QHash<QUrl, QString> m_mimeTypeCache;
         int m_screen = -1;
         bool m_screenUsed;
         ScreenMapper *m_screenMapper = nullptr;
@@ -19,14 +19,17 @@
 
 #include "itemviewadapter.h"
 
+#include <QAbstractItemModel>
 #include <QModelIndex>
 #include <QPalette>
 #include <QSize>
+#include <QtMath>
 
 ItemViewAdapter::ItemViewAdapter(QObject *parent) : KAbstractViewAdapter(parent),
     m_adapterView(nullptr),
     m_adapterModel(nullptr),
-    m_adapterIconSize(-1)
+    m_adapterIconSize(-1),
+    m_adapterFlow(LeftToRight)
 {
 }
 
@@ -52,11 +55,22 @@ QRect ItemViewAdapter::visibleArea() const
 
 QRect ItemViewAdapter::visualRect(const QModelIndex &index) const
 {
-    // FIXME TODO: Implemented on DND branch.
+    const int perStripe = this->perStripe();
 
-    Q_UNUSED(index)
+    if (!index.isValid() || !perStripe) {
+        return QRect();
+    }
+
+    const int stripe = index.row() / perStripe;
+    const int pos = index.row() % perStripe;
+    const qreal width = m_adapterCellSize.width();
+    const qreal height = m_adapterCellSize.height();
+
+    if (m_adapterFlow == LeftToRight) {
+        return QRectF(pos * width, stripe * height, width, height).toAlignedRect();
+    }
 
-    return QRect();
+    return QRectF(stripe * width, pos * height, width, height).toAlignedRect();
 }
 
 void ItemViewAdapter::connect(Signal signal, QObject *receiver, const char *slot)
@@ -123,3 +137,77 @@ void ItemViewAdapter::setAdapterVisibleArea(QRect rect)
         emit adapterVisibleAreaChanged();
     }
 }
+
+QSizeF ItemViewAdapter::adapterCellSize() const
+{
+    return m_adapterCellSize;
+}
+
+void ItemViewAdapter::setAdapterCellSize(const QSizeF &size)
+{
+    if (m_adapterCellSize != size) {
+        m_adapterCellSize = size;
+
+        emit adapterCellSizeChanged();
+    }
+}
+
+ItemViewAdapter::Flow ItemViewAdapter::adapterFlow() const
+{
+    return m_adapterFlow;
+}
+
+void ItemViewAdapter::setAdapterFlow(Flow flow)
+{
+    if (m_adapterFlow != flow) {
+        m_adapterFlow = flow;
+
+        emit adapterFlowChanged();
+    }
+}
+
+int ItemViewAdapter::perStripe() const
+{
+    if (m_adapterCellSize.isEmpty()) {
+        return 0;
+    }
+
+    if (m_adapterFlow == LeftToRight) {
+        return qMax(1, qFloor(m_adapterVisibleArea.width() / m_adapterCellSize.width()));
+    }
+
+    return qMax(1, qFloor(m_adapterVisibleArea.height() / m_adapterCellSize.height()));
+}
+
+QPair<int, int> ItemViewAdapter::rowRange(const QRect &rect) const
+{
+    const int perStripe = this->perStripe();
+
+    if (!perStripe || !m_adapterModel || !rect.isValid()) {
+        return qMakePair(-1, -1);
+    }
+
+    qreal stripeSize = m_adapterCellSize.height();
+    int start = rect.top();
+    int end = rect.bottom();
+
+    if (m_adapterFlow == TopToBottom) {
+        stripeSize = m_adapterCellSize.width();
+        start = rect.left();
+        end = rect.right();
+    }
+
+    if (end < 0) {
+        return qMakePair(-1, -1);
+    }
+
+    const int first = qFloor(qMax(0, start) / stripeSize) * perStripe;
+    const int last = qMin(m_adapterModel->rowCount() - 1,
+        (qFloor(end / stripeSize) + 1) * perStripe - 1);
+
+    if (first > last) {
+        return qMakePair(-1, -1);
+    }
+
+    return qMakePair(first, last);
+}
@@ -20,7 +20,9 @@
 #ifndef ITEMVIEWADAPTER_H
 #define ITEMVIEWADAPTER_H
 
+#include <QPair>
 #include <QRect>
+#include <QSizeF>
 
 #include <KAbstractViewAdapter>
 
@@ -32,8 +34,16 @@ class ItemViewAdapter : public KAbstractViewAdapter
     Q_PROPERTY(QAbstractItemModel* adapterModel READ adapterModel WRITE setAdapterModel NOTIFY adapterModelChanged)
     Q_PROPERTY(int adapterIconSize READ adapterIconSize WRITE setAdapterIconSize NOTIFY adapterIconSizeChanged)
     Q_PROPERTY(QRect adapterVisibleArea READ adapterVisibleArea WRITE setAdapterVisibleArea NOTIFY adapterVisibleAreaChanged)
+    Q_PROPERTY(QSizeF adapterCellSize READ adapterCellSize WRITE setAdapterCellSize NOTIFY adapterCellSizeChanged)
+    Q_PROPERTY(Flow adapterFlow READ adapterFlow WRITE setAdapterFlow NOTIFY adapterFlowChanged)
 
     public:
+        enum Flow {
+            LeftToRight = 0,
+            TopToBottom
+        };
+        Q_ENUM(Flow)
+
         explicit ItemViewAdapter(QObject* parent = nullptr);
 
         QAbstractItemModel *model() const override;
@@ -55,18 +65,35 @@ class ItemViewAdapter : public KAbstractViewAdapter
         QRect adapterVisibleArea() const;
         void setAdapterVisibleArea(QRect rect);
 
+        QSizeF adapterCellSize() const;
+        void setAdapterCellSize(const QSizeF &size);
+
+        Flow adapterFlow() const;
+        void setAdapterFlow(Flow flow);
+
+        // Number of cells per row (or column, for top-to-bottom flow) that fit
+        // into the visible area; 0 as long as the geometry is unknown.
+        int perStripe() const;
+
+        // First and last model row whose cell intersects rect, or (-1, -1).
+        QPair<int, int> rowRange(const QRect &rect) const;
+
     Q_SIGNALS:
         void viewScrolled() const;
         void adapterViewChanged() const;
         void adapterModelChanged() const;
         void adapterIconSizeChanged() const;
         void adapterVisibleAreaChanged() const;
+        void adapterCellSizeChanged() const;
+        void adapterFlowChanged() const;
 
     private:
         QObject *m_adapterView;
         QAbstractItemModel *m_adapterModel;
         int m_adapterIconSize;
         QRect m_adapterVisibleArea;
+        QSizeF m_adapterCellSize;
+        Flow m_adapterFlow;
 };
 
 #endif
@@ -21,9 +21,90 @@
 #include "foldermodel.h"
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QTimer>
 
+#include <algorithm>
 #include <cstdlib>
+#include <functional>
+
+namespace {
+
+/*
+ * Compact positions format: the positions list holds this header followed by
+ * a single base64 string. The payload is a sequence of unsigned LEB128
+ * varints and length prefixed UTF-8 strings:
+ *
+ *   stripes, perStripe,
+ *   prefix count, prefixes...,
+ *   entry count, entries of (prefix index, file name, stripe, pos)...
+ *
+ * URLs are split after their last slash, so items in the same folder share
+ * a single prefix. The legacy format of three strings per item is still
+ * read, but no longer written.
+ *
+ * This is a one-way migration: the first save after an upgrade replaces the
+ * legacy list. Older versions ignore a positions list with fewer than five
+ * entries, so after a downgrade the icons are laid out automatically once and
+ * saved in the legacy format again, nothing else is lost. Writing both
+ * formats would keep the large legacy list in the config, which is exactly
+ * what this format is meant to avoid.
+ */
+const QLatin1String compactPositionsHeader("compact:1");
+
+void writeVarint(QByteArray &data, quint32 value)
+{
+    while (value >= 0x80) {
+        data.append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+
+    data.append(char(value));
+}
+
+bool readVarint(const QByteArray &data, int &offset, quint32 &value)
+{
+    value = 0;
+
+    for (int shift = 0; shift < 32; shift += 7) {
+        if (offset >= data.size()) {
+            return false;
+        }
+
+        const quint8 byte = data.at(offset++);
+        value |= quint32(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void writeString(QByteArray &data, const QString &string)
+{
+    const QByteArray utf8 = string.toUtf8();
+
+    writeVarint(data, utf8.size());
+    data.append(utf8);
+}
+
+bool readString(const QByteArray &data, int &offset, QString &string)
+{
+    quint32 size = 0;
+
+    if (!readVarint(data, offset, size) || size > quint32(data.size() - offset)) {
+        return false;
+    }
+
+    string = QString::fromUtf8(data.constData() + offset, size);
+    offset += size;
+
+    return true;
+}
+
+}
 
 Positioner::Positioner(QObject *parent): QAbstractItemModel(parent)
 , m_enabled(false)
@@ -84,6 +165,8 @@ void Positioner::setFolderModel(QObject *folderModel)
 
         m_folderModel = qobject_cast<FolderModel *>(folderModel);
 
+        invalidateSourceIndex();
+
         if (m_folderModel) {
             connectSignals(m_folderModel);
 
@@ -110,7 +193,7 @@ void Positioner::setPerStripe(int perStripe)
 
         emit perStripeChanged();
 
-        if (m_enabled && perStripe > 0 && !m_proxyToSource.isEmpty()) {
+        if (m_enabled && perStripe > 0 && m_occupiedRows) {
             applyPositions();
         }
     }
@@ -125,6 +208,7 @@ void Positioner::setPositions(const QStringList &positions)
 {
     if (m_positions != positions) {
         m_positions = positions;
+        m_decodedPositions = decodePositions(positions);
 
         emit positionsChanged();
 
@@ -140,7 +224,7 @@ void Positioner::setPositions(const QStringList &positions)
 int Positioner::map(int row) const
 {
     if (m_enabled && m_folderModel) {
-        return m_proxyToSource.value(row, -1);
+        return sourceRow(row);
     }
 
     return row;
@@ -176,45 +260,66 @@ int Positioner::nearestItem(int currentIndex, Qt::ArrowType direction)
             return -1;
     }
 
-    QList<int> rows(m_proxyToSource.keys());
-    std::sort(rows.begin(), rows.end());
-
-    int nearestItem = -1;
-    const QPoint currentPos(currentIndex % m_perStripe, currentIndex / m_perStripe);
-    int lastDistance = -1;
-    int distance = 0;
+    if (m_perStripe <= 0) {
+        return -1;
+    }
 
-    foreach (int row, rows) {
-        const QPoint pos(row % m_perStripe, row / m_perStripe);
+    // The proxy rows form a grid of stripes, so rather than measuring the
+    // distance to every item, look at the cells around the current one in
+    // rings of growing Manhattan distance and stop at the first ring with
+    // an item on it.
+    const int currentX = currentIndex % m_perStripe;
+    const int currentY = currentIndex / m_perStripe;
+    const int maxDistance = (m_perStripe - 1) + (m_lastOccupiedRow / m_perStripe);
 
-        if (row == currentIndex) {
-            continue;
+    auto itemAt = [this](int x, int y) {
+        if (x < 0 || x >= m_perStripe || y < 0) {
+            return -1;
         }
 
-        if (hDirection == 0) {
-            if (vDirection * pos.y() > vDirection * currentPos.y()) {
-                distance = (pos - currentPos).manhattanLength();
+        const int row = (y * m_perStripe) + x;
 
-                if (nearestItem == -1 || distance < lastDistance
-                    || (distance == lastDistance && pos.x() == currentPos.x())) {
-                    nearestItem = row;
-                    lastDistance = distance;
+        return (sourceRow(row) != -1) ? row : -1;
+    };
+
+    for (int distance = 1; distance <= maxDistance; ++distance) {
+        int nearestItem = -1;
+
+        // 'along' is the offset in the direction of travel, 'across' the
+        // offset to either side of it.
+        for (int along = 1; along <= distance; ++along) {
+            const int across = distance - along;
+
+            for (int side = -1; side <= 1; side += 2) {
+                if (across == 0 && side == 1) {
+                    continue;
                 }
-            }
-        } else if (vDirection == 0) {
-            if (hDirection * pos.x() > hDirection * currentPos.x()) {
-                distance = (pos - currentPos).manhattanLength();
 
-                if (nearestItem == -1 || distance < lastDistance
-                    || (distance == lastDistance && pos.y() == currentPos.y())) {
+                const int row = (hDirection == 0)
+                    ? itemAt(currentX + (side * across), currentY + (vDirection * along))
+                    : itemAt(currentX + (hDirection * along), currentY + (side * across));
+
+                if (row == -1) {
+                    continue;
+                }
+
+                // Prefer the item in the same row or column on ties.
+                if (across == 0) {
+                    return row;
+                }
+
+                if (nearestItem == -1 || row < nearestItem) {
                     nearestItem = row;
-                    lastDistance = distance;
                 }
             }
         }
+
+        if (nearestItem != -1) {
+            return nearestItem;
+        }
     }
 
-    return nearestItem;
+    return -1;
 }
 
 bool Positioner::isBlank(int row) const
@@ -223,9 +328,11 @@ bool Positioner::isBlank(int row) const
         return m_folderModel->isBlank(row);
     }
 
-    if (m_proxyToSource.contains(row) &&
+    const int source = sourceRow(row);
+
+    if (source != -1 &&
             m_folderModel &&
-            !m_folderModel->isBlank(m_proxyToSource.value(row))) {
+            !m_folderModel->isBlank(source)) {
         return false;
     }
 
@@ -238,20 +345,9 @@ int Positioner::indexForUrl(const QUrl &url) const
         return -1;
     }
 
-    const QString &name = url.fileName();
-
-    int sourceIndex = -1;
-
-    // TODO Optimize.
-    for (int i = 0; i < m_folderModel->rowCount(); ++i) {
-        if (m_folderModel->data(m_folderModel->index(i, 0), FolderModel::FileNameRole).toString() == name) {
-            sourceIndex = i;
-
-            break;
-        }
-    }
+    ensureSourceIndex();
 
-    return m_sourceToProxy.value(sourceIndex, -1);
+    return proxyRow(m_sourceRowForName.value(url.fileName(), -1));
 }
 
 void Positioner::setRangeSelected(int anchor, int to)
@@ -264,8 +360,10 @@ void Positioner::setRangeSelected(int anchor, int to)
         QVariantList indices;
 
         for (int i = qMin(anchor, to); i <= qMax(anchor, to); ++i) {
-            if (m_proxyToSource.contains(i)) {
-                indices.append(m_proxyToSource.value(i));
+            const int source = sourceRow(i);
+
+            if (source != -1) {
+                indices.append(source);
             }
         }
 
@@ -308,8 +406,10 @@ QVariant Positioner::data(const QModelIndex &index, int role) const
 
     if (m_folderModel) {
         if (m_enabled) {
-            if (m_proxyToSource.contains(index.row())) {
-                return m_folderModel->data(m_folderModel->index(m_proxyToSource.value(index.row()), 0), role);
+            const int source = sourceRow(index.row());
+
+            if (source != -1) {
+                return m_folderModel->data(m_folderModel->index(source, 0), role);
             } else if (role == FolderModel::BlankRole) {
                 return true;
             }
@@ -358,6 +458,7 @@ void Positioner::reset()
     endResetModel();
 
     m_positions = QStringList();
+    m_decodedPositions.clear();
     emit positionsChanged();
 }
 
@@ -377,11 +478,7 @@ void Positioner::move(const QVariantList &moves) {
         const int v = moves[i].toInt();
 
         if (isFrom) {
-            if (m_proxyToSource.contains(v)) {
-                sourceRows.append(m_proxyToSource.value(v));
-            } else {
-                sourceRows.append(-1);
-            }
+            sourceRows.append(sourceRow(v));
         }
 
         (isFrom ? fromIndices : toIndices).append(v);
@@ -419,7 +516,7 @@ void Positioner::move(const QVariantList &moves) {
         toIndices[i] = to;
 
         if (!toIndices.contains(from)) {
-            m_proxyToSource.remove(from);
+            clearProxyRow(from);
         }
 
         updateMaps(to, sourceRow);
@@ -455,38 +552,204 @@ void Positioner::move(const QVariantList &moves) {
 void Positioner::updatePositions()
 {
     QStringList positions;
+    QVector<Position> decodedPositions;
 
-    if (m_enabled && !m_proxyToSource.isEmpty() && m_perStripe > 0) {
-        positions.append(QString::number((1 + ((rowCount() - 1) / m_perStripe))));
-        positions.append(QString::number(m_perStripe));
+    if (m_enabled && m_occupiedRows && m_perStripe > 0) {
+        decodedPositions.reserve(m_occupiedRows);
 
-        QHashIterator<int, int> it(m_proxyToSource);
+        for (int row = 0; row <= m_lastOccupiedRow; ++row) {
+            const int source = m_proxyToSource.at(row);
 
-        while (it.hasNext()) {
-            it.next();
+            if (source == -1) {
+                continue;
+            }
 
-            const QString &name = m_folderModel->data(m_folderModel->index(it.value(), 0),
+            const QString &name = m_folderModel->data(m_folderModel->index(source, 0),
                 FolderModel::UrlRole).toString();
 
             if (name.isEmpty()) {
-                qDebug() << this << it.value() << "Source model doesn't know this index!";
+                qDebug() << this << source << "Source model doesn't know this index!";
 
                 return;
             }
 
-            positions.append(name);
-            positions.append(QString::number(qMax(0, it.key() / m_perStripe)));
-            positions.append(QString::number(qMax(0, it.key() % m_perStripe)));
+            decodedPositions.append({name, qMax(0, row / m_perStripe), qMax(0, row % m_perStripe)});
         }
+
+        positions = encodePositions(1 + ((rowCount() - 1) / m_perStripe), m_perStripe, decodedPositions);
     }
 
     if (positions != m_positions) {
         m_positions = positions;
+        m_decodedPositions = decodedPositions;
 
         emit positionsChanged();
     }
 }
 
+QStringList Positioner::encodePositions(int stripes, int perStripe, const QVector<Position> &positions)
+{
+    QHash<QString, int> prefixIndices;
+    QStringList prefixes;
+    QByteArray entries;
+
+    for (const Position &position : positions) {
+        const int slash = position.url.lastIndexOf(QLatin1Char('/')) + 1;
+        const QString prefix = position.url.left(slash);
+
+        auto it = prefixIndices.constFind(prefix);
+
+        if (it == prefixIndices.constEnd()) {
+            it = prefixIndices.insert(prefix, prefixes.count());
+            prefixes.append(prefix);
+        }
+
+        writeVarint(entries, it.value());
+        writeString(entries, position.url.mid(slash));
+        writeVarint(entries, position.stripe);
+        writeVarint(entries, position.pos);
+    }
+
+    QByteArray data;
+    writeVarint(data, stripes);
+    writeVarint(data, perStripe);
+    writeVarint(data, prefixes.count());
+
+    for (const QString &prefix : qAsConst(prefixes)) {
+        writeString(data, prefix);
+    }
+
+    writeVarint(data, positions.count());
+    data.append(entries);
+
+    return {compactPositionsHeader, QString::fromLatin1(data.toBase64())};
+}
+
+QVector<Positioner::Position> Positioner::decodePositions(const QStringList &positions,
+    int *stripes, int *perStripe)
+{
+    QVector<Position> decoded;
+
+    if (positions.count() == 2 && positions.at(0) == compactPositionsHeader) {
+        const QByteArray data = QByteArray::fromBase64(positions.at(1).toLatin1());
+        int offset = 0;
+        quint32 stripeCount = 0;
+        quint32 stripeSize = 0;
+        quint32 prefixCount = 0;
+        quint32 count = 0;
+
+        if (!readVarint(data, offset, stripeCount)
+            || !readVarint(data, offset, stripeSize)
+            || !readVarint(data, offset, prefixCount)) {
+            return {};
+        }
+
+        QStringList prefixes;
+
+        for (quint32 i = 0; i < prefixCount; ++i) {
+            QString prefix;
+
+            if (!readString(data, offset, prefix)) {
+                return {};
+            }
+
+            prefixes.append(prefix);
+        }
+
+        if (!readVarint(data, offset, count)) {
+            return {};
+        }
+
+        // Each entry takes at least four bytes, don't trust larger counts.
+        decoded.reserve(qMin(count, quint32(data.size() - offset) / 4));
+
+        for (quint32 i = 0; i < count; ++i) {
+            quint32 prefix = 0;
+            QString fileName;
+            quint32 stripe = 0;
+            quint32 pos = 0;
+
+            if (!readVarint(data, offset, prefix) || prefix >= quint32(prefixes.count())
+                || !readString(data, offset, fileName)
+                || !readVarint(data, offset, stripe)
+                || !readVarint(data, offset, pos)) {
+                return {};
+            }
+
+            decoded.append({prefixes.at(prefix) + fileName, int(stripe), int(pos)});
+        }
+
+        if (stripes) {
+            *stripes = stripeCount;
+        }
+
+        if (perStripe) {
+            *perStripe = stripeSize;
+        }
+
+        return decoded;
+    }
+
+    // Legacy format: stripes, perStripe, then url, stripe and pos for each item.
+    if (positions.count() < 5 || (positions.count() - 2) % 3 != 0) {
+        return {};
+    }
+
+    bool ok = false;
+    decoded.reserve((positions.count() - 2) / 3);
+
+    for (int i = 2; i < positions.count(); i += 3) {
+        Position position;
+        position.url = positions.at(i);
+        position.stripe = positions.at(i + 1).toInt(&ok);
+
+        if (!ok) {
+            return {};
+        }
+
+        position.pos = positions.at(i + 2).toInt(&ok);
+
+        if (!ok) {
+            return {};
+        }
+
+        decoded.append(position);
+    }
+
+    if (stripes) {
+        *stripes = positions.at(0).toInt();
+    }
+
+    if (perStripe) {
+        *perStripe = positions.at(1).toInt();
+    }
+
+    return decoded;
+}
+
+#ifdef BUILD_TESTING
+QStringList Positioner::expandPositions(const QStringList &positions)
+{
+    int stripes = 0;
+    int perStripe = 0;
+    const QVector<Position> decoded = decodePositions(positions, &stripes, &perStripe);
+
+    if (decoded.isEmpty()) {
+        return {};
+    }
+
+    QStringList expanded;
+    expanded.reserve(2 + (decoded.count() * 3));
+    expanded << QString::number(stripes) << QString::number(perStripe);
+
+    for (const Position &position : decoded) {
+        expanded << position.url << QString::number(position.stripe) << QString::number(position.pos);
+    }
+
+    return expanded;
+}
+#endif
+
 void Positioner::sourceStatusChanged()
 {
     if (m_deferApplyPositions && m_folderModel->status() != FolderModel::Listing) {
@@ -502,13 +765,20 @@ void Positioner::sourceStatusChanged()
 void Positioner::sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight,
     const QVector<int>& roles)
 {
+    // A rename changes the name and URL of the item.
+    if (roles.isEmpty() || roles.contains(Qt::DisplayRole)) {
+        invalidateSourceIndex();
+    }
+
     if (m_enabled) {
         int start = topLeft.row();
         int end = bottomRight.row();
 
         for (int i = start; i <= end; ++i) {
-            if (m_sourceToProxy.contains(i)) {
-                const QModelIndex &idx = index(m_sourceToProxy.value(i), 0);
+            const int proxy = proxyRow(i);
+
+            if (proxy != -1) {
+                const QModelIndex &idx = index(proxy, 0);
 
                 emit dataChanged(idx, idx);
             }
@@ -525,6 +795,8 @@ void Positioner::sourceModelAboutToBeReset()
 
 void Positioner::sourceModelReset()
 {
+    invalidateSourceIndex();
+
     if (m_enabled) {
         initMaps();
     }
@@ -539,7 +811,7 @@ void Positioner::sourceRowsAboutToBeInserted(const QModelIndex &parent, int star
         // initial positions;
         if (m_deferApplyPositions) {
             return;
-        } else if (m_proxyToSource.isEmpty()) {
+        } else if (!m_occupiedRows) {
             beginInsertRows(parent, start, end);
             m_beginInsertRowsCalled = true;
 
@@ -552,13 +824,13 @@ void Positioner::sourceRowsAboutToBeInserted(const QModelIndex &parent, int star
         // In this case we must update first the existing proxy->source and source->proxy
         // mapping, otherwise the proxy items will point to the wrong source item.
         int count = end - start + 1;
-        m_sourceToProxy.clear();
-        for (auto it = m_proxyToSource.begin(); it != m_proxyToSource.end(); ++it) {
-            int sourceIdx = *it;
+        for (int &sourceIdx : m_proxyToSource) {
             if (sourceIdx >= start) {
-                *it += count;
+                sourceIdx += count;
             }
-            m_sourceToProxy[*it] = it.key();
+        }
+        if (start < m_sourceToProxy.count()) {
+            m_sourceToProxy.insert(start, count, -1);
         }
 
         int free = -1;
@@ -608,30 +880,25 @@ void Positioner::sourceRowsAboutToBeRemoved(const QModelIndex &parent, int first
         int oldLast = lastRow();
 
         for (int i = first; i <= last; ++i) {
-            int proxyRow = m_sourceToProxy.take(i);
-            m_proxyToSource.remove(proxyRow);
-            m_pendingChanges << createIndex(proxyRow, 0);
+            const int proxy = proxyRow(i);
+
+            if (proxy != -1 && sourceRow(proxy) == i) {
+                clearProxyRow(proxy);
+                m_pendingChanges << createIndex(proxy, 0);
+            }
         }
 
-        QHash<int, int> newProxyToSource;
-        QHash<int, int> newSourceToProxy;
-        QHashIterator<int, int> it(m_sourceToProxy);
         int delta = std::abs(first - last) + 1;
 
-        while (it.hasNext()) {
-            it.next();
-
-            if (it.key() > last) {
-                newProxyToSource.insert(it.value(), it.key() - delta);
-                newSourceToProxy.insert(it.key() - delta, it.value());
-            } else {
-                newProxyToSource.insert(it.value(), it.key());
-                newSourceToProxy.insert(it.key(), it.value());
+        for (int &sourceIdx : m_proxyToSource) {
+            if (sourceIdx > last) {
+                sourceIdx -= delta;
             }
         }
 
-        m_proxyToSource = newProxyToSource;
-        m_sourceToProxy = newSourceToProxy;
+        if (first < m_sourceToProxy.count()) {
+            m_sourceToProxy.remove(first, qMin(delta, m_sourceToProxy.count() - first));
+        }
 
         int newLast = lastRow();
 
@@ -660,6 +927,8 @@ void Positioner::sourceRowsInserted(const QModelIndex &parent, int first, int la
     Q_UNUSED(first)
     Q_UNUSED(last)
 
+    invalidateSourceIndex();
+
     if (!m_ignoreNextTransaction) {
         if (m_beginInsertRowsCalled) {
             endInsertRows();
@@ -687,6 +956,8 @@ void Positioner::sourceRowsMoved(const QModelIndex &sourceParent, int sourceStar
     Q_UNUSED(destinationParent)
     Q_UNUSED(destinationRow)
 
+    invalidateSourceIndex();
+
     emit endMoveRows();
 }
 
@@ -696,6 +967,8 @@ void Positioner::sourceRowsRemoved(const QModelIndex &parent, int first, int las
     Q_UNUSED(first)
     Q_UNUSED(last)
 
+    invalidateSourceIndex();
+
     if (!m_ignoreNextTransaction) {
         emit endRemoveRows();
     } else {
@@ -712,6 +985,8 @@ void Positioner::sourceLayoutChanged(const QList<QPersistentModelIndex>& parents
 {
     Q_UNUSED(parents)
 
+    invalidateSourceIndex();
+
     if (m_enabled) {
         initMaps();
     }
@@ -719,10 +994,43 @@ void Positioner::sourceLayoutChanged(const QList<QPersistentModelIndex>& parents
     emit layoutChanged(QList<QPersistentModelIndex>(), hint);
 }
 
+void Positioner::invalidateSourceIndex()
+{
+    m_sourceIndexValid = false;
+}
+
+void Positioner::ensureSourceIndex() const
+{
+    if (m_sourceIndexValid) {
+        return;
+    }
+
+    m_sourceIndexValid = true;
+    m_sourceRowForName.clear();
+    m_sourceRowForUrl.clear();
+
+    if (!m_folderModel) {
+        return;
+    }
+
+    const int count = m_folderModel->rowCount();
+
+    m_sourceRowForName.reserve(count);
+    m_sourceRowForUrl.reserve(count);
+
+    for (int i = 0; i < count; ++i) {
+        const QUrl url = m_folderModel->data(m_folderModel->index(i, 0), FolderModel::UrlRole).toUrl();
+
+        if (!url.isEmpty()) {
+            m_sourceRowForName.insert(url.fileName(), i);
+            m_sourceRowForUrl.insert(url.toString(), i);
+        }
+    }
+}
+
 void Positioner::initMaps(int size)
 {
-    m_proxyToSource.clear();
-    m_sourceToProxy.clear();
+    clearMaps();
 
     if (size == -1) {
         size = m_folderModel->rowCount();
@@ -737,45 +1045,107 @@ void Positioner::initMaps(int size)
     }
 }
 
+void Positioner::clearMaps()
+{
+    m_proxyToSource.clear();
+    m_sourceToProxy.clear();
+    m_freeRows.clear();
+    m_occupiedRows = 0;
+    m_lastOccupiedRow = -1;
+}
+
 void Positioner::updateMaps(int proxyIndex, int sourceIndex)
 {
-    m_proxyToSource.insert(proxyIndex, sourceIndex);
-    m_sourceToProxy.insert(sourceIndex, proxyIndex);
+    if (proxyIndex >= m_proxyToSource.count()) {
+        m_proxyToSource.insert(m_proxyToSource.count(), proxyIndex + 1 - m_proxyToSource.count(), -1);
+    }
+
+    if (sourceIndex >= m_sourceToProxy.count()) {
+        m_sourceToProxy.insert(m_sourceToProxy.count(), sourceIndex + 1 - m_sourceToProxy.count(), -1);
+    }
+
+    if (m_proxyToSource.at(proxyIndex) == -1) {
+        ++m_occupiedRows;
+
+        if (proxyIndex > m_lastOccupiedRow) {
+            // Rows skipped over are now holes below the last row.
+            for (int i = m_lastOccupiedRow + 1; i < proxyIndex; ++i) {
+                m_freeRows.append(i);
+                std::push_heap(m_freeRows.begin(), m_freeRows.end(), std::greater<int>());
+            }
+
+            m_lastOccupiedRow = proxyIndex;
+        }
+    }
+
+    m_proxyToSource[proxyIndex] = sourceIndex;
+    m_sourceToProxy[sourceIndex] = proxyIndex;
 }
 
-int Positioner::firstRow() const
+void Positioner::clearProxyRow(int proxyIndex)
 {
-    if (!m_proxyToSource.isEmpty()) {
-        QList<int> keys(m_proxyToSource.keys());
-        std::sort(keys.begin(), keys.end());
+    if (sourceRow(proxyIndex) == -1) {
+        return;
+    }
+
+    m_proxyToSource[proxyIndex] = -1;
+    --m_occupiedRows;
 
-        return keys.first();
+    if (proxyIndex == m_lastOccupiedRow) {
+        do {
+            --m_lastOccupiedRow;
+        } while (m_lastOccupiedRow >= 0 && m_proxyToSource.at(m_lastOccupiedRow) == -1);
+    } else {
+        m_freeRows.append(proxyIndex);
+        std::push_heap(m_freeRows.begin(), m_freeRows.end(), std::greater<int>());
     }
+}
 
-    return -1;
+int Positioner::sourceRow(int proxyIndex) const
+{
+    if (proxyIndex < 0 || proxyIndex >= m_proxyToSource.count()) {
+        return -1;
+    }
+
+    return m_proxyToSource.at(proxyIndex);
 }
 
-int Positioner::lastRow() const
+int Positioner::proxyRow(int sourceIndex) const
 {
-    if (!m_proxyToSource.isEmpty()) {
-        QList<int> keys(m_proxyToSource.keys());
-        std::sort(keys.begin(), keys.end());
-        return keys.last();
+    if (sourceIndex < 0 || sourceIndex >= m_sourceToProxy.count()) {
+        return -1;
     }
 
-    return 0;
+    return m_sourceToProxy.at(sourceIndex);
+}
+
+int Positioner::firstRow() const
+{
+    for (int i = 0; i <= m_lastOccupiedRow; ++i) {
+        if (m_proxyToSource.at(i) != -1) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int Positioner::lastRow() const
+{
+    return qMax(0, m_lastOccupiedRow);
 }
 
 int Positioner::firstFreeRow() const
 {
-    if (!m_proxyToSource.isEmpty()) {
-        int last = lastRow();
+    while (!m_freeRows.isEmpty()) {
+        const int row = m_freeRows.first();
 
-        for (int i = 0; i <= last; ++i) {
-            if (!m_proxyToSource.contains(i)) {
-                return i;
-            }
+        if (row < m_lastOccupiedRow && m_proxyToSource.at(row) == -1) {
+            return row;
         }
+
+        std::pop_heap(m_freeRows.begin(), m_freeRows.end(), std::greater<int>());
+        m_freeRows.removeLast();
     }
 
     return -1;
@@ -792,7 +1162,7 @@ void Positioner::applyPositions()
     }
 
 
-    if (m_positions.size() < 5) {
+    if (m_decodedPositions.isEmpty()) {
         // We were waiting for listing to complete before proxying source rows,
         // but we don't have positions to apply. Reset to populate.
         if (m_deferApplyPositions) {
@@ -803,73 +1173,46 @@ void Positioner::applyPositions()
         return;
     }
 
-    beginResetModel();
+    QElapsedTimer timer;
+    timer.start();
 
-    m_proxyToSource.clear();
-    m_sourceToProxy.clear();
-
-    const QStringList &positions = m_positions.mid(2);
-
-    if (positions.count() % 3 != 0) {
-        return;
-    }
+    beginResetModel();
 
-    QHash<QString, int> sourceIndices;
+    clearMaps();
 
-    for (int i = 0; i < m_folderModel->rowCount(); ++i) {
-        sourceIndices.insert(m_folderModel->data(m_folderModel->index(i, 0),
-            FolderModel::UrlRole).toString(), i);
-    }
+    ensureSourceIndex();
+    QHash<QString, int> sourceIndices = m_sourceRowForUrl;
 
-    QString name;
-    int stripe = -1;
-    int pos = -1;
     int sourceIndex = -1;
     int index = -1;
-    bool ok = false;
-    int offset = 0;
 
     // Restore positions for items that still fit.
-    for (int i = 0; i < positions.count() / 3; ++i) {
-        offset = i * 3;
-        pos = positions.at(offset + 2).toInt(&ok);
-        if (!ok) { return; }
-
-        if (pos <= m_perStripe) {
-            name = positions.at(offset);
-            stripe = positions.at(offset + 1).toInt(&ok);
-            if (!ok) { return; }
-
-            if (!sourceIndices.contains(name)) {
+    for (const Position &position : qAsConst(m_decodedPositions)) {
+        if (position.pos <= m_perStripe) {
+            if (!sourceIndices.contains(position.url)) {
                 continue;
             } else {
-                sourceIndex = sourceIndices.value(name);
+                sourceIndex = sourceIndices.value(position.url);
             }
 
-            index = (stripe * m_perStripe) + pos;
+            index = (position.stripe * m_perStripe) + position.pos;
 
-            if (m_proxyToSource.contains(index)) {
+            if (index < 0 || sourceRow(index) != -1) {
                 continue;
             }
 
             updateMaps(index, sourceIndex);
-            sourceIndices.remove(name);
+            sourceIndices.remove(position.url);
         }
     }
 
     // Find new positions for items that didn't fit.
-    for (int i = 0; i < positions.count() / 3; ++i) {
-        offset = i * 3;
-        pos = positions.at(offset + 2).toInt(&ok);
-        if (!ok) { return; }
-
-        if (pos > m_perStripe) {
-            name = positions.at(offset);
-
-            if (!sourceIndices.contains(name)) {
+    for (const Position &position : qAsConst(m_decodedPositions)) {
+        if (position.pos > m_perStripe) {
+            if (!sourceIndices.contains(position.url)) {
                 continue;
             } else {
-                sourceIndex = sourceIndices.take(name);
+                sourceIndex = sourceIndices.take(position.url);
             }
 
             index = firstFreeRow();
@@ -899,6 +1242,9 @@ void Positioner::applyPositions()
 
     endResetModel();
 
+    qCDebug(FOLDERMODEL_TIMING) << "Applying" << m_decodedPositions.count() << "positions took"
+        << timer.elapsed() << "ms";
+
     m_deferApplyPositions = false;
 
     m_updatePositionsTimer->start();
@@ -78,11 +78,24 @@ class FOLDERPLUGIN_TESTS_EXPORT Positioner : public QAbstractItemModel
 
 #ifdef BUILD_TESTING
         QHash<int, int> proxyToSourceMapping() const {
-            return m_proxyToSource;
+            QHash<int, int> mapping;
+            for (int i = 0; i < m_proxyToSource.count(); ++i) {
+                if (m_proxyToSource.at(i) != -1) {
+                    mapping.insert(i, m_proxyToSource.at(i));
+                }
+            }
+            return mapping;
         }
         QHash<int, int> sourceToProxyMapping() const {
-            return m_sourceToProxy;
+            QHash<int, int> mapping;
+            for (int i = 0; i < m_sourceToProxy.count(); ++i) {
+                if (m_sourceToProxy.at(i) != -1) {
+                    mapping.insert(i, m_sourceToProxy.at(i));
+                }
+            }
+            return mapping;
         }
+        static QStringList expandPositions(const QStringList &positions);
 #endif
 
     Q_SIGNALS:
@@ -112,8 +125,24 @@ class FOLDERPLUGIN_TESTS_EXPORT Positioner : public QAbstractItemModel
             QAbstractItemModel::LayoutChangeHint hint);
 
     private:
+        struct Position {
+            QString url;
+            int stripe;
+            int pos;
+        };
+
+        static QStringList encodePositions(int stripes, int perStripe, const QVector<Position> &positions);
+        static QVector<Position> decodePositions(const QStringList &positions,
+            int *stripes = nullptr, int *perStripe = nullptr);
+
+        void invalidateSourceIndex();
+        void ensureSourceIndex() const;
         void initMaps(int size = -1);
+        void clearMaps();
         void updateMaps(int proxyIndex, int sourceIndex);
+        void clearProxyRow(int proxyIndex);
+        int sourceRow(int proxyIndex) const;
+        int proxyRow(int sourceIndex) const;
         int firstRow() const;
         int lastRow() const;
         int firstFreeRow() const;
@@ -132,13 +161,28 @@ class FOLDERPLUGIN_TESTS_EXPORT Positioner : public QAbstractItemModel
         QModelIndexList m_pendingChanges;
         bool m_ignoreNextTransaction;
 
+        // Positions as exposed to and stored by QML, plus the decoded entries.
         QStringList m_positions;
+        QVector<Position> m_decodedPositions;
         bool m_deferApplyPositions;
         QVariantList m_deferMovePositions;
         QTimer *m_updatePositionsTimer;
 
-        QHash<int, int> m_proxyToSource;
-        QHash<int, int> m_sourceToProxy;
+        // Dense mappings indexed by proxy and source row, -1 marks a blank
+        // proxy row or a source row that isn't placed (yet).
+        QVector<int> m_proxyToSource;
+        QVector<int> m_sourceToProxy;
+        int m_occupiedRows = 0;
+        int m_lastOccupiedRow = -1;
+        // Min-heap of blank rows below m_lastOccupiedRow. Rows are pushed when
+        // they become blank and stale entries are dropped lazily.
+        mutable QVector<int> m_freeRows;
+        // Source rows by file name and by URL string. Any change to the source
+        // rows only marks them stale, they are rebuilt in one pass on the next
+        // lookup, so listing a folder row by row stays linear.
+        mutable QHash<QString, int> m_sourceRowForName;
+        mutable QHash<QString, int> m_sourceRowForUrl;
+        mutable bool m_sourceIndexValid = false;
         bool m_beginInsertRowsCalled = false; // used to sync the amount of begin/endInsertRows calls
 };
 
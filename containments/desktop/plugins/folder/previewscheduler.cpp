@@ -0,0 +1,416 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#include "previewscheduler.h"
+#include "foldermodel.h"
+#include "itemviewadapter.h"
+
+#include <QIcon>
+#include <QPixmap>
+#include <QTimer>
+
+#include <KCoreDirLister>
+#include <KDirModel>
+#include <KIO/PreviewJob>
+
+// Number of items handed to a single preview job. Small batches keep the
+// visible items at the front and let scrolling cancel work quickly.
+static const int s_itemsPerJob = 8;
+
+PreviewScheduler::PreviewScheduler(KDirModel *dirModel, QObject *parent) : QObject(parent),
+    m_dirModel(dirModel),
+    m_enabled(false),
+    m_maximumJobs(2),
+    m_prefetchPages(1),
+    m_updateTimer(new QTimer(this))
+{
+    m_updateTimer->setInterval(0);
+    m_updateTimer->setSingleShot(true);
+    connect(m_updateTimer, &QTimer::timeout, this, &PreviewScheduler::updateQueue);
+
+    connect(m_dirModel, &QAbstractItemModel::rowsInserted, this, &PreviewScheduler::schedule);
+    connect(m_dirModel, &QAbstractItemModel::modelReset, this, &PreviewScheduler::reset);
+    connect(m_dirModel, &QAbstractItemModel::rowsAboutToBeRemoved,
+            this, [this](const QModelIndex &parent, int first, int last) {
+        for (int i = first; i <= last; ++i) {
+            m_done.remove(m_dirModel->itemForIndex(m_dirModel->index(i, 0, parent)).url());
+        }
+    });
+
+    connect(m_dirModel->dirLister(), &KCoreDirLister::refreshItems, this,
+            [this](const QList<QPair<KFileItem, KFileItem>> &items) {
+        // The file changed on disk, so its preview is outdated.
+        for (const auto &item : items) {
+            m_done.remove(item.first.url());
+            m_done.remove(item.second.url());
+        }
+
+        schedule();
+    });
+}
+
+PreviewScheduler::~PreviewScheduler()
+{
+    m_queue.clear();
+    killJobs();
+}
+
+ItemViewAdapter *PreviewScheduler::viewAdapter() const
+{
+    return m_viewAdapter;
+}
+
+void PreviewScheduler::setViewAdapter(ItemViewAdapter *adapter)
+{
+    if (m_viewAdapter == adapter) {
+        return;
+    }
+
+    if (m_viewAdapter) {
+        disconnect(m_viewAdapter, nullptr, this, nullptr);
+    }
+
+    m_viewAdapter = adapter;
+
+    if (m_viewAdapter) {
+        connect(m_viewAdapter, &ItemViewAdapter::adapterVisibleAreaChanged, this, &PreviewScheduler::schedule);
+        connect(m_viewAdapter, &ItemViewAdapter::adapterCellSizeChanged, this, &PreviewScheduler::schedule);
+        connect(m_viewAdapter, &ItemViewAdapter::adapterFlowChanged, this, &PreviewScheduler::schedule);
+        connect(m_viewAdapter, &ItemViewAdapter::adapterModelChanged, this, &PreviewScheduler::adapterModelChanged);
+        connect(m_viewAdapter, &ItemViewAdapter::adapterIconSizeChanged, this, &PreviewScheduler::reset);
+    }
+
+    adapterModelChanged();
+}
+
+bool PreviewScheduler::enabled() const
+{
+    return m_enabled;
+}
+
+void PreviewScheduler::setEnabled(bool enabled)
+{
+    if (m_enabled != enabled) {
+        m_enabled = enabled;
+
+        if (m_enabled) {
+            schedule();
+        } else {
+            m_queue.clear();
+            m_wanted.clear();
+            killJobs();
+            clearPreviews();
+        }
+    }
+}
+
+QStringList PreviewScheduler::enabledPlugins() const
+{
+    return m_enabledPlugins;
+}
+
+void PreviewScheduler::setEnabledPlugins(const QStringList &plugins)
+{
+    if (m_enabledPlugins != plugins) {
+        m_enabledPlugins = plugins;
+
+        m_queue.clear();
+        killJobs();
+        clearPreviews();
+        schedule();
+    }
+}
+
+int PreviewScheduler::maximumJobs() const
+{
+    return m_maximumJobs;
+}
+
+void PreviewScheduler::setMaximumJobs(int jobs)
+{
+    jobs = qMax(1, jobs);
+
+    if (m_maximumJobs != jobs) {
+        m_maximumJobs = jobs;
+
+        startJobs();
+    }
+}
+
+int PreviewScheduler::prefetchPages() const
+{
+    return m_prefetchPages;
+}
+
+void PreviewScheduler::setPrefetchPages(int pages)
+{
+    pages = qMax(0, pages);
+
+    if (m_prefetchPages != pages) {
+        m_prefetchPages = pages;
+
+        schedule();
+    }
+}
+
+void PreviewScheduler::schedule()
+{
+    if (m_enabled) {
+        m_updateTimer->start();
+    }
+}
+
+void PreviewScheduler::reset()
+{
+    m_queue.clear();
+    killJobs();
+
+    // Previews already shown stay until their replacements arrive.
+    m_done.clear();
+
+    schedule();
+}
+
+void PreviewScheduler::adapterModelChanged()
+{
+    QAbstractItemModel *model = m_viewAdapter ? m_viewAdapter->adapterModel() : nullptr;
+
+    if (m_adapterModel == model) {
+        return;
+    }
+
+    if (m_adapterModel) {
+        disconnect(m_adapterModel, nullptr, this, nullptr);
+    }
+
+    m_adapterModel = model;
+
+    // The adapter model may be a Positioner, whose rows move around
+    // without the directory model changing.
+    if (m_adapterModel) {
+        connect(m_adapterModel, &QAbstractItemModel::rowsInserted, this, &PreviewScheduler::schedule);
+        connect(m_adapterModel, &QAbstractItemModel::rowsRemoved, this, &PreviewScheduler::schedule);
+        connect(m_adapterModel, &QAbstractItemModel::rowsMoved, this, &PreviewScheduler::schedule);
+        connect(m_adapterModel, &QAbstractItemModel::layoutChanged, this, &PreviewScheduler::schedule);
+        connect(m_adapterModel, &QAbstractItemModel::modelReset, this, &PreviewScheduler::schedule);
+    }
+
+    schedule();
+}
+
+void PreviewScheduler::updateQueue()
+{
+    m_queue.clear();
+    m_wanted.clear();
+
+    if (!m_enabled || !m_dirModel || !m_viewAdapter || !m_adapterModel) {
+        killJobs();
+        return;
+    }
+
+    const QRect visible = m_viewAdapter->adapterVisibleArea();
+    const QPair<int, int> visibleRows = m_viewAdapter->rowRange(visible);
+
+    if (visibleRows.first == -1) {
+        killJobs();
+        return;
+    }
+
+    QRect prefetch = visible;
+
+    if (m_viewAdapter->adapterFlow() == ItemViewAdapter::LeftToRight) {
+        const int margin = visible.height() * m_prefetchPages;
+        prefetch.adjust(0, -margin, 0, margin);
+    } else {
+        const int margin = visible.width() * m_prefetchPages;
+        prefetch.adjust(-margin, 0, margin, 0);
+    }
+
+    const QPair<int, int> prefetchRows = m_viewAdapter->rowRange(prefetch);
+
+    for (int row = visibleRows.first; row <= visibleRows.second; ++row) {
+        enqueueRow(row);
+    }
+
+    // Work outwards from the visible area, favoring the direction the
+    // user is most likely to scroll in next.
+    int after = visibleRows.second + 1;
+    int before = visibleRows.first - 1;
+
+    while (after <= prefetchRows.second || before >= prefetchRows.first) {
+        if (after <= prefetchRows.second) {
+            enqueueRow(after++);
+        }
+
+        if (before >= prefetchRows.first) {
+            enqueueRow(before--);
+        }
+    }
+
+    // Drop pending requests for items that scrolled out of range.
+    QList<KIO::PreviewJob *> finishedJobs;
+
+    for (auto it = m_jobs.begin(); it != m_jobs.end(); ) {
+        QSet<QUrl> &urls = it.value();
+
+        for (auto urlIt = urls.begin(); urlIt != urls.end(); ) {
+            if (m_wanted.contains(*urlIt)) {
+                ++urlIt;
+                continue;
+            }
+
+            it.key()->removeItem(*urlIt);
+            m_inFlight.remove(*urlIt);
+            urlIt = urls.erase(urlIt);
+        }
+
+        if (urls.isEmpty()) {
+            finishedJobs.append(it.key());
+            it = m_jobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (KIO::PreviewJob *job : qAsConst(finishedJobs)) {
+        job->kill();
+    }
+
+    startJobs();
+}
+
+void PreviewScheduler::enqueueRow(int row)
+{
+    const QUrl url = m_adapterModel->index(row, 0).data(FolderModel::UrlRole).toUrl();
+
+    // Blank cells in the Positioner have no url.
+    if (url.isEmpty()) {
+        return;
+    }
+
+    m_wanted.insert(url);
+
+    if (m_done.contains(url) || m_inFlight.contains(url)) {
+        return;
+    }
+
+    const KFileItem item = m_dirModel->itemForIndex(m_dirModel->indexForUrl(url));
+
+    if (!item.isNull()) {
+        m_queue.append(item);
+    }
+}
+
+void PreviewScheduler::startJobs()
+{
+    if (!m_viewAdapter) {
+        return;
+    }
+
+    while (m_jobs.count() < m_maximumJobs && !m_queue.isEmpty()) {
+        KFileItemList items;
+        QSet<QUrl> urls;
+
+        while (items.count() < s_itemsPerJob && !m_queue.isEmpty()) {
+            const KFileItem item = m_queue.takeFirst();
+            items.append(item);
+            urls.insert(item.url());
+        }
+
+        KIO::PreviewJob *job = KIO::filePreview(items, m_viewAdapter->iconSize(),
+            m_enabledPlugins.isEmpty() ? nullptr : &m_enabledPlugins);
+
+        connect(job, &KIO::PreviewJob::gotPreview, this, &PreviewScheduler::gotPreview);
+        connect(job, &KIO::PreviewJob::failed, this, &PreviewScheduler::previewFailed);
+        connect(job, &KJob::finished, this, &PreviewScheduler::jobFinished);
+
+        m_inFlight.unite(urls);
+        m_jobs.insert(job, urls);
+    }
+}
+
+void PreviewScheduler::killJobs()
+{
+    const QList<KIO::PreviewJob *> jobs = m_jobs.keys();
+
+    m_jobs.clear();
+    m_inFlight.clear();
+
+    for (KIO::PreviewJob *job : jobs) {
+        job->kill();
+    }
+}
+
+void PreviewScheduler::clearPreviews()
+{
+    if (m_dirModel) {
+        for (const QUrl &url : qAsConst(m_done)) {
+            const QModelIndex index = m_dirModel->indexForUrl(url);
+
+            if (index.isValid()) {
+                m_dirModel->setData(index, QIcon(), Qt::DecorationRole);
+            }
+        }
+    }
+
+    m_done.clear();
+}
+
+void PreviewScheduler::itemDone(const KFileItem &item)
+{
+    const QUrl url = item.url();
+
+    m_done.insert(url);
+    m_inFlight.remove(url);
+
+    auto it = m_jobs.find(static_cast<KIO::PreviewJob *>(sender()));
+
+    if (it != m_jobs.end()) {
+        it.value().remove(url);
+    }
+}
+
+void PreviewScheduler::gotPreview(const KFileItem &item, const QPixmap &pixmap)
+{
+    itemDone(item);
+
+    if (!m_dirModel) {
+        return;
+    }
+
+    const QModelIndex index = m_dirModel->indexForItem(item);
+
+    if (index.isValid()) {
+        m_dirModel->setData(index, QIcon(pixmap), Qt::DecorationRole);
+    }
+}
+
+void PreviewScheduler::previewFailed(const KFileItem &item)
+{
+    itemDone(item);
+}
+
+void PreviewScheduler::jobFinished(KJob *job)
+{
+    const QSet<QUrl> urls = m_jobs.take(static_cast<KIO::PreviewJob *>(job));
+
+    for (const QUrl &url : urls) {
+        m_inFlight.remove(url);
+    }
+
+    startJobs();
+}
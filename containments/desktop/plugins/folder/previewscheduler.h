@@ -0,0 +1,112 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA .        *
+ ***************************************************************************/
+
+#ifndef PREVIEWSCHEDULER_H
+#define PREVIEWSCHEDULER_H
+
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QStringList>
+#include <QUrl>
+
+#include <KFileItem>
+
+class QAbstractItemModel;
+class QPixmap;
+class QTimer;
+
+class KDirModel;
+class KJob;
+
+namespace KIO {
+    class PreviewJob;
+}
+
+class ItemViewAdapter;
+
+/**
+ * Generates preview thumbnails for the items the view is actually showing.
+ *
+ * Items in the visible area are requested first, followed by the items
+ * within prefetchPages() view heights (or widths, depending on the flow)
+ * of it. Items further away are left alone until the view scrolls close
+ * to them, and pending requests for items that scrolled out of range are
+ * dropped. At most maximumJobs() preview jobs run at the same time.
+ */
+class PreviewScheduler : public QObject
+{
+    Q_OBJECT
+
+    public:
+        explicit PreviewScheduler(KDirModel *dirModel, QObject *parent = nullptr);
+        ~PreviewScheduler() override;
+
+        ItemViewAdapter *viewAdapter() const;
+        void setViewAdapter(ItemViewAdapter *adapter);
+
+        bool enabled() const;
+        void setEnabled(bool enabled);
+
+        QStringList enabledPlugins() const;
+        void setEnabledPlugins(const QStringList &plugins);
+
+        int maximumJobs() const;
+        void setMaximumJobs(int jobs);
+
+        int prefetchPages() const;
+        void setPrefetchPages(int pages);
+
+    public Q_SLOTS:
+        void schedule();
+        void reset();
+
+    private Q_SLOTS:
+        void adapterModelChanged();
+        void updateQueue();
+        void gotPreview(const KFileItem &item, const QPixmap &pixmap);
+        void previewFailed(const KFileItem &item);
+        void jobFinished(KJob *job);
+
+    private:
+        void enqueueRow(int row);
+        void startJobs();
+        void killJobs();
+        void clearPreviews();
+        void itemDone(const KFileItem &item);
+
+        QPointer<KDirModel> m_dirModel;
+        QPointer<ItemViewAdapter> m_viewAdapter;
+        QPointer<QAbstractItemModel> m_adapterModel;
+        bool m_enabled;
+        QStringList m_enabledPlugins;
+        int m_maximumJobs;
+        int m_prefetchPages;
+        QTimer *m_updateTimer;
+        // Items waiting for a job, in the order they should be requested.
+        KFileItemList m_queue;
+        // Urls within the visible area and the prefetch margin around it.
+        QSet<QUrl> m_wanted;
+        // Urls that already got a preview, or for which none could be made.
+        QSet<QUrl> m_done;
+        // Urls each running job still has to deliver.
+        QHash<KIO::PreviewJob *, QSet<QUrl>> m_jobs;
+        QSet<QUrl> m_inFlight;
+};
+
+#endif
@@ -21,6 +21,7 @@
 
 #include <QApplication>
 #include <QStyleOptionRubberBand>
+#include <QtMath>
 
 RubberBand::RubberBand(QQuickItem *parent) : QQuickPaintedItem(parent)
 {
@@ -52,6 +53,20 @@ bool RubberBand::intersects(const QRectF &rect) const
     return m_geometry.intersects(rect);
 }
 
+QRect RubberBand::intersectedCells(const QSizeF &cellSize) const
+{
+    if (cellSize.isEmpty() || m_geometry.isEmpty()) {
+        return QRect();
+    }
+
+    const int firstColumn = qMax(0, qFloor(m_geometry.left() / cellSize.width()));
+    const int firstRow = qMax(0, qFloor(m_geometry.top() / cellSize.height()));
+    const int lastColumn = qFloor(m_geometry.right() / cellSize.width());
+    const int lastRow = qFloor(m_geometry.bottom() / cellSize.height());
+
+    return QRect(QPoint(firstColumn, firstRow), QPoint(lastColumn, lastRow));
+}
+
 void RubberBand::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
 {
     Q_UNUSED(oldGeometry);
@@ -34,6 +34,10 @@ class RubberBand : public QQuickPaintedItem
 
         Q_INVOKABLE bool intersects(const QRectF &rect) const;
 
+        // Columns (x, width) and rows (y, height) of a grid of the given
+        // cell size that the rubber band covers.
+        Q_INVOKABLE QRect intersectedCells(const QSizeF &cellSize) const;
+
     protected:
         void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry) override;
 
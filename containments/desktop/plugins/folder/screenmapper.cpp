@@ -27,6 +27,8 @@
 #include <KConfig>
 #include <KConfigGroup>
 
+#include <algorithm>
+
 ScreenMapper *ScreenMapper::instance()
 {
     static ScreenMapper *s_instance = new ScreenMapper();
@@ -36,26 +38,21 @@ ScreenMapper *ScreenMapper::instance()
 ScreenMapper::ScreenMapper(QObject *parent)
     : QObject(parent)
     , m_screenMappingChangedTimer(new QTimer(this))
+    , m_saveMappingTimer(new QTimer(this))
 
 {
     connect(m_screenMappingChangedTimer, &QTimer::timeout,
             this, &ScreenMapper::screenMappingChanged);
 
-    connect(this, &ScreenMapper::screenMappingChanged, this, [this] {
-       if (!m_corona)
-           return;
-
-       auto config = m_corona->config();
-       KConfigGroup group(config, QLatin1String("ScreenMapping"));
-       group.writeEntry(QLatin1String("screenMapping"), screenMapping());
-       config->sync();
-    });
-
     // used to compress screenMappingChanged signals when addMapping is called multiple times,
     // eg. from FolderModel::filterAcceptRows. The timer interval is an arbitrary number,
     // that doesn't delay too much the signal, but still compresses as much as possible
     m_screenMappingChangedTimer->setInterval(100);
     m_screenMappingChangedTimer->setSingleShot(true);
+
+    m_saveMappingTimer->setInterval(0);
+    m_saveMappingTimer->setSingleShot(true);
+    connect(m_saveMappingTimer, &QTimer::timeout, this, &ScreenMapper::saveScreenMapping);
 }
 
 void ScreenMapper::removeScreen(int screenId, const QUrl &screenUrl)
@@ -70,20 +67,17 @@ void ScreenMapper::removeScreen(int screenId, const QUrl &screenUrl)
     while (it != m_screenItemMap.constEnd()) {
         const auto name = it.key();
         if (it.value() == screenId && name.url().startsWith(screenPathWithScheme)) {
-            bool found = false;
-            for (const auto &disabledUrls: qAsConst(m_itemsOnDisabledScreensMap)) {
-                found = disabledUrls.contains(name);
-                if (found)
-                    break;
+            if (!m_disabledScreenForItem.contains(name)) {
+                m_itemsOnDisabledScreensMap[screenId].insert(name);
+                m_disabledScreenForItem.insert(name, screenId);
             }
-            if (!found)
-                m_itemsOnDisabledScreensMap[screenId].append(name);
             urlsToRemoveFromMapping.append(name);
         }
         ++it;
     }
 
-    saveDisabledScreensMap();
+    if (!urlsToRemoveFromMapping.isEmpty())
+        disabledScreensMapChanged();
 
     for (const auto &url: urlsToRemoveFromMapping)
         removeFromMap(url);
@@ -113,22 +107,24 @@ void ScreenMapper::addScreen(int screenId, const QUrl &screenUrl)
     // restore the stored locations
     auto it = m_itemsOnDisabledScreensMap.find(screenId);
     if (it != m_itemsOnDisabledScreensMap.end()) {
-        auto items = it.value();
-        for (const auto &name: it.value()) {
+        auto &items = it.value();
+        for (auto itemIt = items.begin(); itemIt != items.end(); ) {
             // add the items to the new screen, if they are on a disabled screen and their
             // location is below the new screen's path
+            const QUrl name = *itemIt;
             if (name.url().startsWith(screenPathWithScheme)) {
                 addMapping(name, screenId, DelayedSignal);
-                items.removeAll(name);
+                m_disabledScreenForItem.remove(name);
+                itemIt = items.erase(itemIt);
+                disabledScreensMapChanged();
+            } else {
+                ++itemIt;
             }
         }
         if (items.isEmpty()) {
             m_itemsOnDisabledScreensMap.erase(it);
-        } else {
-            *it = items;
         }
     }
-    saveDisabledScreensMap();
 
     m_availableScreens.append(screenId);
 
@@ -147,9 +143,18 @@ void ScreenMapper::addScreen(int screenId, const QUrl &screenUrl)
 
 void ScreenMapper::addMapping(const QUrl &url, int screen, MappingSignalBehavior behavior)
 {
+    auto it = m_screenItemMap.find(url);
+    if (it != m_screenItemMap.end() && it.value() == screen)
+        return;
+
     m_screenItemMap[url] = screen;
+    mappingChanged(url);
+
     if (behavior == DelayedSignal) {
-        m_screenMappingChangedTimer->start();
+        // don't restart a running timer, or a steady stream of changes
+        // would keep postponing the signal
+        if (!m_screenMappingChangedTimer->isActive())
+            m_screenMappingChangedTimer->start();
     } else {
         emit screenMappingChanged();
     }
@@ -157,8 +162,19 @@ void ScreenMapper::addMapping(const QUrl &url, int screen, MappingSignalBehavior
 
 void ScreenMapper::removeFromMap(const QUrl &url)
 {
-    m_screenItemMap.remove(url);
-    m_screenMappingChangedTimer->start();
+    if (!m_screenItemMap.remove(url))
+        return;
+
+    mappingChanged(url);
+
+    if (!m_screenMappingChangedTimer->isActive())
+        m_screenMappingChangedTimer->start();
+}
+
+void ScreenMapper::mappingChanged(const QUrl &url)
+{
+    m_dirtyMappings.insert(url);
+    m_saveMappingTimer->start();
 }
 
 int ScreenMapper::firstAvailableScreen(const QUrl &screenUrl) const
@@ -170,11 +186,25 @@ int ScreenMapper::firstAvailableScreen(const QUrl &screenUrl) const
 
 void ScreenMapper::removeItemFromDisabledScreen(const QUrl &url)
 {
-    for (auto it = m_itemsOnDisabledScreensMap.begin();
-         it != m_itemsOnDisabledScreensMap.end(); ++it) {
-        auto urls = &(*it);
-        urls->removeAll(url);
+    auto it = m_disabledScreenForItem.find(url);
+    if (it == m_disabledScreenForItem.end())
+        return;
+
+    auto screenIt = m_itemsOnDisabledScreensMap.find(it.value());
+    if (screenIt != m_itemsOnDisabledScreensMap.end()) {
+        screenIt->remove(url);
+        if (screenIt->isEmpty())
+            m_itemsOnDisabledScreensMap.erase(screenIt);
     }
+
+    m_disabledScreenForItem.erase(it);
+    disabledScreensMapChanged();
+}
+
+void ScreenMapper::disabledScreensMapChanged()
+{
+    m_disabledScreensMapChanged = true;
+    m_saveMappingTimer->start();
 }
 
 void ScreenMapper::setSharedDesktop(bool sharedDesktops)
@@ -194,9 +224,14 @@ void ScreenMapper::setSharedDesktop(bool sharedDesktops)
 void ScreenMapper::cleanup()
 {
     m_screenItemMap.clear();
+    m_dirtyMappings.clear();
     m_itemsOnDisabledScreensMap.clear();
+    m_disabledScreenForItem.clear();
+    m_disabledScreensMapChanged = false;
     m_screensPerPath.clear();
     m_availableScreens.clear();
+    m_mappingPrefixes.clear();
+    m_mappingPrefixIds.clear();
 }
 #endif
 
@@ -216,8 +251,7 @@ void ScreenMapper::setCorona(Plasma::Corona *corona)
 
             auto config = m_corona->config();
             KConfigGroup group(config, QLatin1String("ScreenMapping"));
-            const QStringList mapping = group.readEntry(QLatin1String("screenMapping"), QStringList{});
-            setScreenMapping(mapping);
+            loadScreenMapping(group);
             m_sharedDesktops = group.readEntry(QLatin1String("sharedDesktops"), false);
             readDisabledScreensMap();
         }
@@ -251,6 +285,15 @@ void ScreenMapper::setScreenMapping(const QStringList &mapping)
     }
 
     if (m_screenItemMap != newMap) {
+        for (auto it = m_screenItemMap.constBegin(); it != m_screenItemMap.constEnd(); ++it) {
+            if (newMap.value(it.key(), -1) != it.value())
+                mappingChanged(it.key());
+        }
+        for (auto it = newMap.constBegin(); it != newMap.constEnd(); ++it) {
+            if (!m_screenItemMap.contains(it.key()))
+                mappingChanged(it.key());
+        }
+
         m_screenItemMap = newMap;
         emit screenMappingChanged();
     }
@@ -279,29 +322,27 @@ void ScreenMapper::readDisabledScreensMap()
     KConfigGroup group(config, QLatin1String("ScreenMapping"));
     const QStringList serializedMap  = group.readEntry(QLatin1String("itemsOnDisabledScreens"), QStringList{});
     m_itemsOnDisabledScreensMap.clear();
-    bool readingScreenId = true;
-    int vectorSize = -1;
-    int screenId = -1;
-    int vectorCounter = 0;
-    for (const auto &entry : serializedMap) {
-        if (readingScreenId) {
-            screenId = entry.toInt();
-            readingScreenId = false;
-        } else if (vectorSize == -1) {
-            vectorSize = entry.toInt();
-        } else {
-            const auto url = stringToUrl(entry);
-            m_itemsOnDisabledScreensMap[screenId].append(url);
-            vectorCounter++;
-            if (vectorCounter == vectorSize) {
-                readingScreenId = true;
-                screenId = -1;
-                vectorCounter = 0;
-                vectorSize = -1;
+    m_disabledScreenForItem.clear();
+    // the entry is a sequence of screen id, item count and that many item urls
+    const int count = serializedMap.count();
+    int i = 0;
+    while (i + 1 < count) {
+        const int screenId = serializedMap.at(i).toInt();
+        const int end = qMin(count, i + 2 + qMax(0, serializedMap.at(i + 1).toInt()));
+        i += 2;
+
+        QSet<QUrl> urls;
+        urls.reserve(end - i);
+        for (; i < end; ++i) {
+            const auto url = stringToUrl(serializedMap.at(i));
+            if (!m_disabledScreenForItem.contains(url)) {
+                urls.insert(url);
+                m_disabledScreenForItem.insert(url, screenId);
             }
         }
+        if (!urls.isEmpty())
+            m_itemsOnDisabledScreensMap[screenId].unite(urls);
     }
-
 }
 
 void ScreenMapper::saveDisabledScreensMap() const
@@ -312,16 +353,163 @@ void ScreenMapper::saveDisabledScreensMap() const
     auto config = m_corona->config();
     KConfigGroup group(config, QLatin1String("ScreenMapping"));
     QStringList serializedMap;
-    auto it = m_itemsOnDisabledScreensMap.constBegin();
-    for (; it != m_itemsOnDisabledScreensMap.constEnd(); ++it) {
-        serializedMap.append(QString::number(it.key()));
-        const auto urls= it.value();
+    // screens and their items are written sorted, so the entry only changes
+    // with its content and not with the order of the hashes
+    QList<int> screens = m_itemsOnDisabledScreensMap.keys();
+    std::sort(screens.begin(), screens.end());
+    for (const int screen : qAsConst(screens)) {
+        serializedMap.append(QString::number(screen));
+        const auto &urls = m_itemsOnDisabledScreensMap[screen];
         serializedMap.append(QString::number(urls.size()));
+        QStringList items;
+        items.reserve(urls.size());
         for (const auto &url : urls) {
-            serializedMap.append(url.toString());
+            items.append(url.toString());
         }
+        items.sort();
+        serializedMap.append(items);
     }
 
     group.writeEntry(QLatin1String("itemsOnDisabledScreens"), serializedMap);
 
 }
+
+static QString mappingPrefix(const QUrl &url, const QString &path)
+{
+    const QString prefix = url.adjusted(QUrl::RemoveFilename | QUrl::RemoveQuery | QUrl::RemoveFragment).toString();
+    return path.startsWith(prefix) ? prefix : QString();
+}
+
+QString ScreenMapper::mappingKey(const QUrl &url, bool intern)
+{
+    const QString path = url.toString();
+    const QString prefix = mappingPrefix(url, path);
+
+    auto it = m_mappingPrefixIds.constFind(prefix);
+    if (it == m_mappingPrefixIds.constEnd()) {
+        if (!intern)
+            return QString();
+
+        it = m_mappingPrefixIds.insert(prefix, m_mappingPrefixes.count());
+        m_mappingPrefixes.append(prefix);
+    }
+
+    // the remainder is percent encoded so it can't clash with KConfig's key syntax
+    return QString::number(it.value()) + QLatin1Char('/')
+        + QString::fromLatin1(QUrl::toPercentEncoding(path.mid(prefix.length())));
+}
+
+void ScreenMapper::loadScreenMapping(const KConfigGroup &group)
+{
+    if (readScreenMapping(group))
+        return;
+
+    // convert the mapping from the old format, which stored all items in a single entry
+    const QStringList mapping = group.readEntry(QLatin1String("screenMapping"), QStringList{});
+    setScreenMapping(mapping);
+    for (auto it = m_screenItemMap.constBegin(); it != m_screenItemMap.constEnd(); ++it)
+        mappingChanged(it.key());
+    // the old entry is left as it is, so going back to an older version
+    // still finds the mapping as it was at the time of the conversion
+}
+
+bool ScreenMapper::readScreenMapping(const KConfigGroup &group)
+{
+    const KConfigGroup items(&group, QLatin1String("Items"));
+    if (!group.hasKey(QLatin1String("screenMappingPrefixes")))
+        return false;
+
+    m_mappingPrefixes = group.readEntry(QLatin1String("screenMappingPrefixes"), QStringList{});
+    m_mappingPrefixIds.clear();
+    for (int i = 0; i < m_mappingPrefixes.count(); ++i)
+        m_mappingPrefixIds.insert(m_mappingPrefixes.at(i), i);
+
+    QHash<QUrl, int> newMap;
+    const QMap<QString, QString> entries = items.entryMap();
+    newMap.reserve(entries.count());
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        const QString &key = it.key();
+        const int separator = key.indexOf(QLatin1Char('/'));
+        bool ok = false;
+        const int prefixId = key.leftRef(separator).toInt(&ok);
+        if (separator < 0 || !ok || prefixId < 0 || prefixId >= m_mappingPrefixes.count())
+            continue;
+
+        const QString path = m_mappingPrefixes.at(prefixId)
+            + QUrl::fromPercentEncoding(key.midRef(separator + 1).toLatin1());
+        newMap[stringToUrl(path)] = it.value().toInt();
+    }
+
+    if (m_screenItemMap != newMap) {
+        m_screenItemMap = newMap;
+        emit screenMappingChanged();
+    }
+
+    return true;
+}
+
+void ScreenMapper::saveScreenMapping()
+{
+    if (!m_corona) {
+        m_dirtyMappings.clear();
+        m_disabledScreensMapChanged = false;
+        return;
+    }
+
+    if (m_dirtyMappings.isEmpty() && !m_disabledScreensMapChanged)
+        return;
+
+    if (m_disabledScreensMapChanged) {
+        saveDisabledScreensMap();
+        m_disabledScreensMapChanged = false;
+    }
+
+    auto config = m_corona->config();
+    KConfigGroup group(config, QLatin1String("ScreenMapping"));
+    writeScreenMapping(group);
+
+    config->sync();
+}
+
+void ScreenMapper::writeScreenMapping(KConfigGroup &group)
+{
+    KConfigGroup items(&group, QLatin1String("Items"));
+    const int prefixCount = m_mappingPrefixes.count();
+    bool removed = false;
+    bool pruned = false;
+
+    for (const auto &url : qAsConst(m_dirtyMappings)) {
+        auto it = m_screenItemMap.constFind(url);
+        if (it != m_screenItemMap.constEnd()) {
+            items.writeEntry(mappingKey(url, true), it.value());
+        } else {
+            const QString key = mappingKey(url, false);
+            if (!key.isEmpty()) {
+                items.deleteEntry(key);
+                removed = true;
+            }
+        }
+    }
+    m_dirtyMappings.clear();
+
+    // Once the last item of a directory is gone its prefix is unused. The keys
+    // embed the prefix ids, so pruning means writing all items again, which
+    // only happens when items were removed.
+    if (removed) {
+        QSet<QString> usedPrefixes;
+        for (auto it = m_screenItemMap.constBegin(); it != m_screenItemMap.constEnd(); ++it)
+            usedPrefixes.insert(mappingPrefix(it.key(), it.key().toString()));
+
+        if (usedPrefixes.count() < m_mappingPrefixes.count()) {
+            m_mappingPrefixes.clear();
+            m_mappingPrefixIds.clear();
+            items.deleteGroup();
+            for (auto it = m_screenItemMap.constBegin(); it != m_screenItemMap.constEnd(); ++it)
+                items.writeEntry(mappingKey(it.key(), true), it.value());
+            pruned = true;
+        }
+    }
+
+    if (pruned || m_mappingPrefixes.count() != prefixCount || !group.hasKey(QLatin1String("screenMappingPrefixes")))
+        group.writeEntry(QLatin1String("screenMappingPrefixes"), m_mappingPrefixes);
+}
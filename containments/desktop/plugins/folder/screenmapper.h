@@ -23,11 +23,13 @@
 #define SCREENMAPPER_H
 
 #include <QObject>
+#include <QSet>
 #include <QVariantHash>
 #include <QVector>
 
 #include "folderplugin_private_export.h"
 
+class KConfigGroup;
 class QTimer;
 
 namespace Plasma {
@@ -65,6 +67,9 @@ public:
 
 #ifdef BUILD_TESTING
     void cleanup();
+    // the config handling of setCorona() and the save timer, without a corona
+    void readConfig(const KConfigGroup &group) { loadScreenMapping(group); }
+    void writeConfig(KConfigGroup &group) { writeScreenMapping(group); }
 #endif
 
     static QUrl stringToUrl(const QString &path);
@@ -76,15 +81,31 @@ Q_SIGNALS:
 private:
     void saveDisabledScreensMap() const;
     void readDisabledScreensMap();
+    void saveScreenMapping();
+    void writeScreenMapping(KConfigGroup &group);
+    void loadScreenMapping(const KConfigGroup &group);
+    bool readScreenMapping(const KConfigGroup &group);
+    void mappingChanged(const QUrl &url);
+    void disabledScreensMapChanged();
+    QString mappingKey(const QUrl &url, bool intern);
 
     ScreenMapper(QObject *parent = nullptr);
 
     QHash<QUrl, int> m_screenItemMap;
-    QHash<int, QVector<QUrl> > m_itemsOnDisabledScreensMap;
+    QHash<int, QSet<QUrl> > m_itemsOnDisabledScreensMap;
+    QHash<QUrl, int> m_disabledScreenForItem; // reverse index of m_itemsOnDisabledScreensMap
     QHash<QUrl, QVector<int> > m_screensPerPath; // screens per registered path
     QVector<int> m_availableScreens;
     Plasma::Corona *m_corona = nullptr;
     QTimer *m_screenMappingChangedTimer = nullptr;
+    // Mappings are written as one config entry per item, keyed by the index of
+    // the item's directory in m_mappingPrefixes. Only entries that changed since
+    // the last save are written, once per event loop turn.
+    QSet<QUrl> m_dirtyMappings;
+    QStringList m_mappingPrefixes;
+    QHash<QString, int> m_mappingPrefixIds;
+    QTimer *m_saveMappingTimer = nullptr;
+    bool m_disabledScreensMapChanged = false;
     bool m_sharedDesktops = false; // all screens share the same desktops, disabling the screen mapping
 };
 